@@ -0,0 +1,313 @@
+#include "atlas.h"
+
+#include <algorithm>
+#include <climits>
+#include <cstring>
+
+#include "gl.h"
+
+namespace gfx
+{
+
+namespace
+{
+
+bool intersects(const RectPacker::Rect& a, const RectPacker::Rect& b)
+{
+  return a.x < b.x + b.width && b.x < a.x + a.width && a.y < b.y + b.height && b.y < a.y + a.height;
+}
+
+bool contains(const RectPacker::Rect& outer, const RectPacker::Rect& inner)
+{
+  return outer.x <= inner.x && outer.y <= inner.y && inner.x + inner.width <= outer.x + outer.width &&
+         inner.y + inner.height <= outer.y + outer.height;
+}
+
+}  // namespace
+
+RectPacker::RectPacker(int width, int height) : m_width(std::max(width, 0)), m_height(std::max(height, 0))
+{
+  clear();
+}
+
+bool RectPacker::insert(int width, int height, Rect* rect)
+{
+  if (width <= 0 || height <= 0) {
+    return false;
+  }
+
+  int best_short = INT_MAX, best_long = INT_MAX;
+  const Rect* best = nullptr;
+
+  for (const Rect& free : m_free) {
+    if (free.width < width || free.height < height) continue;
+    int dx = free.width - width, dy = free.height - height;
+    int short_side = std::min(dx, dy), long_side = std::max(dx, dy);
+    if (short_side < best_short || (short_side == best_short && long_side < best_long)) {
+      best_short = short_side;
+      best_long = long_side;
+      best = &free;
+    }
+  }
+
+  if (!best) {
+    return false;
+  }
+
+  *rect = {best->x, best->y, width, height};
+  split(*rect);
+  prune();
+  return true;
+}
+
+void RectPacker::remove(const Rect& rect)
+{
+  m_free.push_back(rect);
+  merge();
+  prune();
+}
+
+void RectPacker::clear()
+{
+  m_free.clear();
+  if (m_width > 0 && m_height > 0) {
+    m_free.push_back({0, 0, m_width, m_height});
+  }
+}
+
+int RectPacker::width() const { return m_width; }
+
+int RectPacker::height() const { return m_height; }
+
+// every free rectangle the new one overlaps is replaced by the up to four maximal pieces around it
+void RectPacker::split(const Rect& used)
+{
+  std::vector<Rect> pieces;
+
+  for (auto it = m_free.begin(); it != m_free.end();) {
+    const Rect free = *it;
+    if (!intersects(free, used)) {
+      ++it;
+      continue;
+    }
+
+    if (used.x > free.x) {
+      pieces.push_back({free.x, free.y, used.x - free.x, free.height});
+    }
+    if (used.x + used.width < free.x + free.width) {
+      pieces.push_back({used.x + used.width, free.y, free.x + free.width - used.x - used.width, free.height});
+    }
+    if (used.y > free.y) {
+      pieces.push_back({free.x, free.y, free.width, used.y - free.y});
+    }
+    if (used.y + used.height < free.y + free.height) {
+      pieces.push_back({free.x, used.y + used.height, free.width, free.y + free.height - used.y - used.height});
+    }
+
+    it = m_free.erase(it);
+  }
+
+  m_free.insert(m_free.end(), pieces.begin(), pieces.end());
+}
+
+// join free rectangles that line up exactly, so removed entries grow back into the space around them
+void RectPacker::merge()
+{
+  bool merged = true;
+  while (merged) {
+    merged = false;
+    for (std::size_t i = 0; i < m_free.size() && !merged; i++) {
+      for (std::size_t j = i + 1; j < m_free.size() && !merged; j++) {
+        Rect& a = m_free[i];
+        const Rect& b = m_free[j];
+
+        if (a.x == b.x && a.width == b.width && (a.y + a.height == b.y || b.y + b.height == a.y)) {
+          a = {a.x, std::min(a.y, b.y), a.width, a.height + b.height};
+          merged = true;
+        } else if (a.y == b.y && a.height == b.height && (a.x + a.width == b.x || b.x + b.width == a.x)) {
+          a = {std::min(a.x, b.x), a.y, a.width + b.width, a.height};
+          merged = true;
+        }
+
+        if (merged) {
+          m_free.erase(m_free.begin() + j);
+        }
+      }
+    }
+  }
+}
+
+void RectPacker::prune()
+{
+  for (std::size_t i = 0; i < m_free.size(); i++) {
+    for (std::size_t j = i + 1; j < m_free.size(); j++) {
+      if (contains(m_free[j], m_free[i])) {
+        m_free.erase(m_free.begin() + i);
+        i--;
+        break;
+      }
+      if (contains(m_free[i], m_free[j])) {
+        m_free.erase(m_free.begin() + j);
+        j--;
+      }
+    }
+  }
+}
+
+Atlas::Atlas(int width, int height, int channels, int padding, int alignment)
+    : m_image(width, height, channels),
+      m_packer(width / std::max(alignment, 1), height / std::max(alignment, 1)),
+      m_size(0),
+      m_padding(std::max(padding, 0)),
+      m_alignment(std::max(alignment, 1)),
+      m_allocated(false)
+{
+  if (m_image.is_valid()) {
+    std::memset(m_image.data(), 0, m_image.size_bytes());
+  }
+}
+
+Atlas::Id Atlas::insert(const ImageView& image)
+{
+  if (!m_image.is_valid() || !image.is_valid() || image.type() != Image::UNSIGNED_BYTE ||
+      image.channels() != m_image.channels()) {
+    return INVALID_ID;
+  }
+
+  // the packer works in units of the alignment
+  const int width = (image.width() + 2 * m_padding + m_alignment - 1) / m_alignment;
+  const int height = (image.height() + 2 * m_padding + m_alignment - 1) / m_alignment;
+
+  Rect slot;
+  if (!m_packer.insert(width, height, &slot)) {
+    return INVALID_ID;
+  }
+
+  Id id;
+  if (!m_free_ids.empty()) {
+    id = m_free_ids.back();
+    m_free_ids.pop_back();
+  } else {
+    id = static_cast<Id>(m_entries.size());
+    m_entries.emplace_back();
+  }
+
+  Rect area = pixels(slot);
+  m_entries[id] = {{area.x + m_padding, area.y + m_padding, image.width(), image.height()}, slot, true};
+  m_size++;
+
+  fill(slot, &image);
+  return id;
+}
+
+bool Atlas::remove(Id id)
+{
+  if (!contains(id)) {
+    return false;
+  }
+
+  Entry& entry = m_entries[id];
+  fill(entry.slot, nullptr);
+  m_packer.remove(entry.slot);
+
+  entry.used = false;
+  m_free_ids.push_back(id);
+  m_size--;
+  return true;
+}
+
+void Atlas::clear()
+{
+  m_packer.clear();
+  m_entries.clear();
+  m_free_ids.clear();
+  m_size = 0;
+
+  if (m_image.is_valid()) {
+    std::memset(m_image.data(), 0, m_image.size_bytes());
+    m_dirty = {{0, 0, m_image.width(), m_image.height()}};
+  }
+}
+
+bool Atlas::contains(Id id) const { return 0 <= id && id < static_cast<Id>(m_entries.size()) && m_entries[id].used; }
+
+const Atlas::Rect& Atlas::rect(Id id) const { return m_entries[id].rect; }
+
+glm::vec4 Atlas::uv(Id id) const
+{
+  const Rect& r = m_entries[id].rect;
+  const glm::vec2 size(m_image.width(), m_image.height());
+  return glm::vec4(r.x / size.x, r.y / size.y, (r.x + r.width) / size.x, (r.y + r.height) / size.y);
+}
+
+std::size_t Atlas::size() const { return m_size; }
+
+const Image& Atlas::image() const { return m_image; }
+
+void Atlas::upload(gl::Texture& texture, bool generate_mipmap)
+{
+  if (!m_image.is_valid()) {
+    return;
+  }
+
+  texture.bind();
+
+  if (!m_allocated) {
+    texture.allocate(m_image.width(), m_image.height(), m_image.channels());
+    m_dirty = {{0, 0, m_image.width(), m_image.height()}};
+    m_allocated = true;
+  }
+
+  if (m_dirty.empty()) {
+    return;
+  }
+
+  for (const Rect& r : m_dirty) {
+    texture.set_sub_image(ImageView(m_image, r.x, r.y, r.width, r.height), r.x, r.y);
+  }
+  m_dirty.clear();
+
+  if (generate_mipmap) {
+    texture.generate_mipmap();
+  }
+}
+
+Atlas::Rect Atlas::pixels(const Rect& slot) const
+{
+  // the packer is sized in whole units, so slots never reach past the image
+  return {slot.x * m_alignment, slot.y * m_alignment, slot.width * m_alignment, slot.height * m_alignment};
+}
+
+// writes the image into the slot and extrudes its edges over the padding, no image clears the slot
+void Atlas::fill(const Rect& slot, const ImageView* image)
+{
+  const Rect area = pixels(slot);
+  const int bpp = m_image.bytes_per_pixel();
+  const std::size_t stride = static_cast<std::size_t>(m_image.width()) * bpp;
+
+  for (int y = 0; y < area.height; y++) {
+    unsigned char* row = m_image.data() + (area.y + y) * stride + static_cast<std::size_t>(area.x) * bpp;
+
+    if (!image) {
+      std::memset(row, 0, static_cast<std::size_t>(area.width) * bpp);
+      continue;
+    }
+
+    const int w = image->width();
+    const unsigned char* src = image->row(std::clamp(y - m_padding, 0, image->height() - 1));
+    const int left = std::min(m_padding, area.width);
+    const int right = area.width - left - w;
+
+    for (int x = 0; x < left; x++) {
+      std::memcpy(row + x * bpp, src, bpp);
+    }
+    std::memcpy(row + left * bpp, src, static_cast<std::size_t>(w) * bpp);
+    for (int x = 0; x < right; x++) {
+      std::memcpy(row + (left + w + x) * bpp, src + (w - 1) * bpp, bpp);
+    }
+  }
+
+  m_dirty.push_back(area);
+}
+
+}  // namespace gfx
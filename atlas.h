@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cstddef>
+#include <glm/glm.hpp>
+#include <vector>
+
+#include "image.h"
+#include "image_view.h"
+
+namespace gfx
+{
+namespace gl
+{
+struct Texture;
+}
+
+// MaxRects bin packer, free space is kept as a list of maximal, possibly overlapping rectangles
+class RectPacker
+{
+ public:
+  struct Rect {
+    int x, y, width, height;
+  };
+
+  RectPacker(int width, int height);
+
+  // best short side fit, false when no free rectangle is large enough
+  bool insert(int width, int height, Rect* rect);
+  // give the space of a rectangle returned by insert back
+  void remove(const Rect& rect);
+  void clear();
+
+  int width() const;
+  int height() const;
+
+ private:
+  int m_width, m_height;
+  std::vector<Rect> m_free;
+
+  void split(const Rect& used);
+  void merge();
+  void prune();
+};
+
+// many small 8 bit images packed into one, so drawing them needs one texture bind instead of hundreds
+//
+// every entry is surrounded by padding that repeats its edge pixels, filtering near the edge never picks up a
+// neighbour. positions and sizes are rounded up to the alignment, with an alignment of 2^n the entries stay apart
+// in the first n mip levels as well
+class Atlas
+{
+ public:
+  using Id = int;
+  static constexpr Id INVALID_ID = -1;
+
+  using Rect = RectPacker::Rect;
+
+  Atlas(int width, int height, int channels, int padding = 2, int alignment = 4);
+
+  // copies the pixels in, INVALID_ID when the image does not fit anymore or has a different channel count
+  Id insert(const ImageView& image);
+  // frees the space of an entry for later inserts, the id is reused
+  bool remove(Id id);
+  void clear();
+
+  bool contains(Id id) const;
+  // pixels of the entry in the atlas, without padding
+  const Rect& rect(Id id) const;
+  // (u0, v0, u1, v1) of the entry
+  glm::vec4 uv(Id id) const;
+
+  std::size_t size() const;
+  const Image& image() const;
+
+  // uploads the regions that changed since the last upload to the same texture, the first upload allocates it
+  void upload(gl::Texture& texture, bool generate_mipmap = true);
+
+ private:
+  struct Entry {
+    Rect rect;  // pixels
+    Rect slot;  // packer units, including padding
+    bool used;
+  };
+
+  Image m_image;
+  RectPacker m_packer;
+  std::vector<Entry> m_entries;
+  std::vector<Id> m_free_ids;
+  std::vector<Rect> m_dirty;  // in pixels
+  std::size_t m_size;
+  int m_padding, m_alignment;
+  bool m_allocated;  // texture storage exists
+
+  Rect pixels(const Rect& slot) const;
+  void fill(const Rect& slot, const ImageView* image);
+};
+}  // namespace gfx
@@ -0,0 +1,812 @@
+#include "block_compression.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#include "simd.h"
+#include "thread_pool.h"
+
+namespace gfx
+{
+
+namespace
+{
+
+// one 4x4 block, channel major so four pixels fill a vector
+struct Block {
+  alignas(16) float c[4][16];
+};
+
+// the edge blocks of sizes that are not a multiple of 4 repeat the last row and column
+void load_block(const unsigned char* pixels, int width, int height, int channels, int bx, int by, Block& block)
+{
+  for (int i = 0; i < 16; i++) {
+    int x = std::min(bx * 4 + i % 4, width - 1);
+    int y = std::min(by * 4 + i / 4, height - 1);
+    const unsigned char* p = pixels + (static_cast<std::size_t>(y) * width + x) * channels;
+    for (int c = 0; c < 4; c++) {
+      block.c[c][i] = c < channels ? p[c] : (c == 3 ? 255.0f : 0.0f);
+    }
+  }
+}
+
+// nearest palette entry for every pixel, all values are small integers so the float math is exact
+// and the vector path picks the same entries as the scalar one
+void closest(const Block& block, int channels, const float (*palette)[4], int count, unsigned char* index,
+             float* error)
+{
+#if defined(GFX_SSE2)
+  for (int i = 0; i < 16; i += 4) {
+    __m128 best = _mm_set1_ps(FLT_MAX);
+    __m128i best_index = _mm_setzero_si128();
+    for (int p = 0; p < count; p++) {
+      __m128 d = _mm_setzero_ps();
+      for (int c = 0; c < channels; c++) {
+        __m128 diff = _mm_sub_ps(_mm_load_ps(&block.c[c][i]), _mm_set1_ps(palette[p][c]));
+        d = _mm_add_ps(d, _mm_mul_ps(diff, diff));
+      }
+      __m128i less = _mm_castps_si128(_mm_cmplt_ps(d, best));
+      best = _mm_min_ps(d, best);
+      best_index = _mm_or_si128(_mm_and_si128(less, _mm_set1_epi32(p)), _mm_andnot_si128(less, best_index));
+    }
+    alignas(16) int32_t lanes[4];
+    _mm_store_si128(reinterpret_cast<__m128i*>(lanes), best_index);
+    _mm_storeu_ps(error + i, best);
+    for (int j = 0; j < 4; j++) {
+      index[i + j] = static_cast<unsigned char>(lanes[j]);
+    }
+  }
+#else
+  for (int i = 0; i < 16; i++) {
+    float best = FLT_MAX;
+    for (int p = 0; p < count; p++) {
+      float d = 0.0f;
+      for (int c = 0; c < channels; c++) {
+        float diff = block.c[c][i] - palette[p][c];
+        d += diff * diff;
+      }
+      if (d < best) {
+        best = d;
+        index[i] = static_cast<unsigned char>(p);
+      }
+    }
+    error[i] = best;
+  }
+#endif
+}
+
+float masked_sum(const float* error, uint16_t mask)
+{
+  float sum = 0.0f;
+  for (int i = 0; i < 16; i++) {
+    if (mask & (1 << i)) sum += error[i];
+  }
+  return sum;
+}
+
+// bounding box of the masked pixels, inset a little so the interpolated entries land inside the block
+void fit_bbox(const Block& block, int channels, uint16_t mask, float* a, float* b)
+{
+  for (int c = 0; c < channels; c++) {
+    float lo = 255.0f, hi = 0.0f;
+    for (int i = 0; i < 16; i++) {
+      if (mask & (1 << i)) {
+        lo = std::min(lo, block.c[c][i]);
+        hi = std::max(hi, block.c[c][i]);
+      }
+    }
+    float inset = (hi - lo) / 32.0f;
+    a[c] = lo + inset;
+    b[c] = hi - inset;
+  }
+}
+
+// extremes of the masked pixels along the principal axis of their covariance
+void fit_pca(const Block& block, int channels, uint16_t mask, float* a, float* b)
+{
+  float mean[4] = {}, lo[4], hi[4];
+  int n = 0;
+  std::fill(lo, lo + 4, 255.0f);
+  std::fill(hi, hi + 4, 0.0f);
+  for (int i = 0; i < 16; i++) {
+    if (!(mask & (1 << i))) continue;
+    for (int c = 0; c < channels; c++) {
+      mean[c] += block.c[c][i];
+      lo[c] = std::min(lo[c], block.c[c][i]);
+      hi[c] = std::max(hi[c], block.c[c][i]);
+    }
+    n++;
+  }
+  for (int c = 0; c < channels; c++) {
+    mean[c] /= n;
+  }
+
+  float cov[4][4] = {};
+  for (int i = 0; i < 16; i++) {
+    if (!(mask & (1 << i))) continue;
+    for (int r = 0; r < channels; r++) {
+      for (int c = 0; c < channels; c++) {
+        cov[r][c] += (block.c[r][i] - mean[r]) * (block.c[c][i] - mean[c]);
+      }
+    }
+  }
+
+  // power iteration, starting along the bounding box diagonal
+  float axis[4] = {};
+  for (int c = 0; c < channels; c++) {
+    axis[c] = hi[c] - lo[c];
+  }
+  for (int iteration = 0; iteration < 8; iteration++) {
+    float next[4] = {}, length = 0.0f;
+    for (int r = 0; r < channels; r++) {
+      for (int c = 0; c < channels; c++) {
+        next[r] += cov[r][c] * axis[c];
+      }
+      length = std::max(length, std::abs(next[r]));
+    }
+    if (length < 1e-6f) break;
+    for (int c = 0; c < channels; c++) {
+      axis[c] = next[c] / length;
+    }
+  }
+
+  float length = 0.0f;
+  for (int c = 0; c < channels; c++) {
+    length += axis[c] * axis[c];
+  }
+  if (length < 1e-12f) {
+    std::copy(mean, mean + channels, a);
+    std::copy(mean, mean + channels, b);
+    return;
+  }
+  length = std::sqrt(length);
+
+  float t_min = FLT_MAX, t_max = -FLT_MAX;
+  for (int i = 0; i < 16; i++) {
+    if (!(mask & (1 << i))) continue;
+    float t = 0.0f;
+    for (int c = 0; c < channels; c++) {
+      t += (block.c[c][i] - mean[c]) * axis[c] / length;
+    }
+    t_min = std::min(t_min, t);
+    t_max = std::max(t_max, t);
+  }
+
+  for (int c = 0; c < channels; c++) {
+    a[c] = std::clamp(mean[c] + t_min * axis[c] / length, 0.0f, 255.0f);
+    b[c] = std::clamp(mean[c] + t_max * axis[c] / length, 0.0f, 255.0f);
+  }
+}
+
+// least squares endpoints for fixed indices, weight[index] is the share of b in that palette entry
+bool refine(const Block& block, int channels, uint16_t mask, const unsigned char* index, const float* weight, float* a,
+            float* b)
+{
+  float aa = 0.0f, bb = 0.0f, ab = 0.0f, ax[4] = {}, bx[4] = {};
+  for (int i = 0; i < 16; i++) {
+    if (!(mask & (1 << i))) continue;
+    float w = weight[index[i]];
+    aa += (1.0f - w) * (1.0f - w);
+    bb += w * w;
+    ab += (1.0f - w) * w;
+    for (int c = 0; c < channels; c++) {
+      ax[c] += (1.0f - w) * block.c[c][i];
+      bx[c] += w * block.c[c][i];
+    }
+  }
+
+  float det = aa * bb - ab * ab;
+  if (std::abs(det) < 1e-6f) {
+    return false;
+  }
+
+  for (int c = 0; c < channels; c++) {
+    a[c] = std::clamp((ax[c] * bb - bx[c] * ab) / det, 0.0f, 255.0f);
+    b[c] = std::clamp((bx[c] * aa - ax[c] * ab) / det, 0.0f, 255.0f);
+  }
+  return true;
+}
+
+void fit(const Block& block, int channels, uint16_t mask, CompressedImage::Quality quality, float* a, float* b)
+{
+  if (quality == CompressedImage::FAST) {
+    fit_bbox(block, channels, mask, a, b);
+  } else {
+    fit_pca(block, channels, mask, a, b);
+  }
+}
+
+// bc1 color block
+
+inline uint16_t pack_565(const float* c)
+{
+  int r = std::clamp(static_cast<int>(c[0] * 31.0f / 255.0f + 0.5f), 0, 31);
+  int g = std::clamp(static_cast<int>(c[1] * 63.0f / 255.0f + 0.5f), 0, 63);
+  int b = std::clamp(static_cast<int>(c[2] * 31.0f / 255.0f + 0.5f), 0, 31);
+  return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+}
+
+inline void unpack_565(uint16_t c, int* rgb)
+{
+  int r = (c >> 11) & 31, g = (c >> 5) & 63, b = c & 31;
+  rgb[0] = (r << 3) | (r >> 2);
+  rgb[1] = (g << 2) | (g >> 4);
+  rgb[2] = (b << 3) | (b >> 2);
+}
+
+// c0 > c1 selects four colors, otherwise three and transparent black, bc3 always uses four
+void color_palette(uint16_t c0, uint16_t c1, bool four_color, int (*palette)[4])
+{
+  unpack_565(c0, palette[0]);
+  unpack_565(c1, palette[1]);
+  palette[0][3] = palette[1][3] = palette[2][3] = palette[3][3] = 255;
+
+  for (int c = 0; c < 3; c++) {
+    if (four_color) {
+      palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+      palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+    } else {
+      palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+      palette[3][c] = 0;
+    }
+  }
+  if (!four_color) {
+    palette[3][3] = 0;
+  }
+}
+
+struct ColorBlock {
+  uint16_t c0, c1;
+  unsigned char index[16];
+  float error;
+};
+
+ColorBlock fit_color(const Block& block, const float* a, const float* b, uint16_t opaque, bool punch_through)
+{
+  ColorBlock result;
+  result.c0 = pack_565(a);
+  result.c1 = pack_565(b);
+
+  // three color mode is what keeps index 3 free for transparent pixels
+  if (punch_through ? result.c0 > result.c1 : result.c0 < result.c1) {
+    std::swap(result.c0, result.c1);
+  }
+
+  bool four_color = !punch_through;
+  int ints[4][4];
+  color_palette(result.c0, result.c1, four_color, ints);
+
+  float palette[4][4];
+  for (int p = 0; p < 4; p++) {
+    for (int c = 0; c < 4; c++) {
+      palette[p][c] = static_cast<float>(ints[p][c]);
+    }
+  }
+
+  float error[16];
+  closest(block, 3, palette, four_color ? 4 : 3, result.index, error);
+  result.error = masked_sum(error, opaque);
+
+  for (int i = 0; i < 16; i++) {
+    if (!(opaque & (1 << i))) result.index[i] = 3;
+  }
+  return result;
+}
+
+void encode_color(const Block& block, CompressedImage::Quality quality, bool punch_through, unsigned char* out)
+{
+  uint16_t opaque = 0xffff;
+  if (punch_through) {
+    for (int i = 0; i < 16; i++) {
+      if (block.c[3][i] < 128.0f) opaque &= ~(1 << i);
+    }
+  }
+  punch_through = opaque != 0xffff;
+
+  ColorBlock best = {};
+  if (opaque == 0) {
+    std::fill(best.index, best.index + 16, 3);
+  } else {
+    float a[4], b[4];
+    fit(block, 3, opaque, quality, a, b);
+    best = fit_color(block, a, b, opaque, punch_through);
+
+    if (quality == CompressedImage::SLOW) {
+      static const float four[4] = {0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f};
+      static const float three[3] = {0.0f, 1.0f, 0.5f};
+      for (int iteration = 0; iteration < 2 && best.error > 0.0f; iteration++) {
+        if (!refine(block, 3, opaque, best.index, punch_through ? three : four, a, b)) break;
+        ColorBlock candidate = fit_color(block, a, b, opaque, punch_through);
+        if (candidate.error >= best.error) break;
+        best = candidate;
+      }
+    }
+  }
+
+  uint32_t bits = 0;
+  for (int i = 0; i < 16; i++) {
+    bits |= static_cast<uint32_t>(best.index[i]) << (2 * i);
+  }
+  out[0] = best.c0 & 0xff;
+  out[1] = best.c0 >> 8;
+  out[2] = best.c1 & 0xff;
+  out[3] = best.c1 >> 8;
+  for (int i = 0; i < 4; i++) {
+    out[4 + i] = (bits >> (8 * i)) & 0xff;
+  }
+}
+
+void decode_color(const unsigned char* in, bool always_four, unsigned char (*out)[4])
+{
+  uint16_t c0 = in[0] | (in[1] << 8);
+  uint16_t c1 = in[2] | (in[3] << 8);
+  uint32_t bits = in[4] | (in[5] << 8) | (in[6] << 16) | (static_cast<uint32_t>(in[7]) << 24);
+
+  int palette[4][4];
+  color_palette(c0, c1, always_four || c0 > c1, palette);
+
+  for (int i = 0; i < 16; i++) {
+    const int* p = palette[(bits >> (2 * i)) & 3];
+    for (int c = 0; c < 4; c++) {
+      out[i][c] = static_cast<unsigned char>(p[c]);
+    }
+  }
+}
+
+// single channel block shared by bc3 alpha, bc4 and bc5
+
+// a0 > a1 selects eight interpolated values, otherwise six plus 0 and 255
+void channel_palette(int a0, int a1, int* palette)
+{
+  palette[0] = a0;
+  palette[1] = a1;
+  if (a0 > a1) {
+    for (int i = 1; i < 7; i++) {
+      palette[1 + i] = ((7 - i) * a0 + i * a1) / 7;
+    }
+  } else {
+    for (int i = 1; i < 5; i++) {
+      palette[1 + i] = ((5 - i) * a0 + i * a1) / 5;
+    }
+    palette[6] = 0;
+    palette[7] = 255;
+  }
+}
+
+int fit_channel(const Block& block, int channel, int a0, int a1, unsigned char* index)
+{
+  int palette[8];
+  channel_palette(a0, a1, palette);
+
+  int error = 0;
+  for (int i = 0; i < 16; i++) {
+    int v = static_cast<int>(block.c[channel][i]);
+    int best = INT32_MAX;
+    for (int p = 0; p < 8; p++) {
+      int d = (v - palette[p]) * (v - palette[p]);
+      if (d < best) {
+        best = d;
+        index[i] = static_cast<unsigned char>(p);
+      }
+    }
+    error += best;
+  }
+  return error;
+}
+
+void encode_channel(const Block& block, int channel, CompressedImage::Quality quality, unsigned char* out)
+{
+  int lo = 255, hi = 0;
+  int inner_lo = 255, inner_hi = 0;  // ignoring the 0 and 255 the six value mode has for free
+  for (int i = 0; i < 16; i++) {
+    int v = static_cast<int>(block.c[channel][i]);
+    lo = std::min(lo, v);
+    hi = std::max(hi, v);
+    if (v != 0 && v != 255) {
+      inner_lo = std::min(inner_lo, v);
+      inner_hi = std::max(inner_hi, v);
+    }
+  }
+
+  unsigned char index[16], candidate[16];
+  int a0 = hi, a1 = lo;
+  int error = fit_channel(block, channel, a0, a1, index);
+
+  auto consider = [&](int c0, int c1) {
+    int e = fit_channel(block, channel, c0, c1, candidate);
+    if (e < error) {
+      error = e;
+      a0 = c0;
+      a1 = c1;
+      std::copy(candidate, candidate + 16, index);
+    }
+  };
+
+  if (quality != CompressedImage::FAST && error > 0 && inner_lo <= inner_hi) {
+    consider(inner_lo, inner_hi);
+  }
+
+  // nudge the endpoints inwards, the extremes are rarely the best pair when the values cluster
+  if (quality == CompressedImage::SLOW && error > 0) {
+    for (int d0 = 0; d0 <= 3; d0++) {
+      for (int d1 = 0; d1 <= 3; d1++) {
+        if (hi - d0 > lo + d1) consider(hi - d0, lo + d1);
+      }
+    }
+  }
+
+  uint64_t bits = 0;
+  for (int i = 0; i < 16; i++) {
+    bits |= static_cast<uint64_t>(index[i]) << (3 * i);
+  }
+  out[0] = static_cast<unsigned char>(a0);
+  out[1] = static_cast<unsigned char>(a1);
+  for (int i = 0; i < 6; i++) {
+    out[2 + i] = (bits >> (8 * i)) & 0xff;
+  }
+}
+
+void decode_channel(const unsigned char* in, unsigned char* out, int stride)
+{
+  int palette[8];
+  channel_palette(in[0], in[1], palette);
+
+  uint64_t bits = 0;
+  for (int i = 0; i < 6; i++) {
+    bits |= static_cast<uint64_t>(in[2 + i]) << (8 * i);
+  }
+  for (int i = 0; i < 16; i++) {
+    out[i * stride] = static_cast<unsigned char>(palette[(bits >> (3 * i)) & 7]);
+  }
+}
+
+// bc7 mode 6, one subset of rgba endpoints with 7 bits and a p-bit each, 4 bit indices
+
+const int BC7_WEIGHTS[16] = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+
+struct Bc7Block {
+  int e[2][4];  // 7 bit endpoints
+  int p[2];     // p-bits
+  unsigned char index[16];
+  float error;
+};
+
+// the p-bit is shared by all channels of an endpoint, pick the one that loses less
+void quantize_endpoint(const float* v, int* e, int* p)
+{
+  float best = FLT_MAX;
+  for (int bit = 0; bit < 2; bit++) {
+    int q[4];
+    float error = 0.0f;
+    for (int c = 0; c < 4; c++) {
+      q[c] = std::clamp(static_cast<int>((v[c] - bit) / 2.0f + 0.5f), 0, 127);
+      float d = static_cast<float>((q[c] << 1) | bit) - v[c];
+      error += d * d;
+    }
+    if (error < best) {
+      best = error;
+      std::copy(q, q + 4, e);
+      *p = bit;
+    }
+  }
+}
+
+void bc7_palette(const int (*e)[4], const int* p, float (*palette)[4])
+{
+  for (int i = 0; i < 16; i++) {
+    int w = BC7_WEIGHTS[i];
+    for (int c = 0; c < 4; c++) {
+      int e0 = (e[0][c] << 1) | p[0];
+      int e1 = (e[1][c] << 1) | p[1];
+      palette[i][c] = static_cast<float>(((64 - w) * e0 + w * e1 + 32) >> 6);
+    }
+  }
+}
+
+Bc7Block fit_bc7(const Block& block, const float* a, const float* b)
+{
+  Bc7Block result;
+  quantize_endpoint(a, result.e[0], &result.p[0]);
+  quantize_endpoint(b, result.e[1], &result.p[1]);
+
+  float palette[16][4], error[16];
+  bc7_palette(result.e, result.p, palette);
+  closest(block, 4, palette, 16, result.index, error);
+  result.error = masked_sum(error, 0xffff);
+  return result;
+}
+
+class BitWriter
+{
+ public:
+  explicit BitWriter(unsigned char* out) : m_out(out), m_position(0) { std::memset(out, 0, 16); }
+
+  void write(uint32_t value, int bits)
+  {
+    for (int i = 0; i < bits; i++, m_position++) {
+      m_out[m_position / 8] |= ((value >> i) & 1) << (m_position % 8);
+    }
+  }
+
+ private:
+  unsigned char* m_out;
+  int m_position;
+};
+
+class BitReader
+{
+ public:
+  explicit BitReader(const unsigned char* in) : m_in(in), m_position(0) {}
+
+  uint32_t read(int bits)
+  {
+    uint32_t value = 0;
+    for (int i = 0; i < bits; i++, m_position++) {
+      value |= ((m_in[m_position / 8] >> (m_position % 8)) & 1u) << i;
+    }
+    return value;
+  }
+
+ private:
+  const unsigned char* m_in;
+  int m_position;
+};
+
+void encode_bc7(const Block& block, CompressedImage::Quality quality, unsigned char* out)
+{
+  float a[4], b[4];
+  fit(block, 4, 0xffff, quality, a, b);
+  Bc7Block best = fit_bc7(block, a, b);
+
+  if (quality == CompressedImage::SLOW) {
+    float weight[16];
+    for (int i = 0; i < 16; i++) {
+      weight[i] = BC7_WEIGHTS[i] / 64.0f;
+    }
+    for (int iteration = 0; iteration < 2 && best.error > 0.0f; iteration++) {
+      if (!refine(block, 4, 0xffff, best.index, weight, a, b)) break;
+      Bc7Block candidate = fit_bc7(block, a, b);
+      if (candidate.error >= best.error) break;
+      best = candidate;
+    }
+  }
+
+  // the msb of the first index is implicit zero, swapping the endpoints mirrors the indices
+  if (best.index[0] & 8) {
+    std::swap(best.e[0], best.e[1]);
+    std::swap(best.p[0], best.p[1]);
+    for (int i = 0; i < 16; i++) {
+      best.index[i] = static_cast<unsigned char>(15 - best.index[i]);
+    }
+  }
+
+  BitWriter writer(out);
+  writer.write(1 << 6, 7);
+  for (int c = 0; c < 4; c++) {
+    writer.write(best.e[0][c], 7);
+    writer.write(best.e[1][c], 7);
+  }
+  writer.write(best.p[0], 1);
+  writer.write(best.p[1], 1);
+  writer.write(best.index[0], 3);
+  for (int i = 1; i < 16; i++) {
+    writer.write(best.index[i], 4);
+  }
+}
+
+// only mode 6 is written here, blocks in other modes decode to black
+void decode_bc7(const unsigned char* in, unsigned char (*out)[4])
+{
+  BitReader reader(in);
+  if (reader.read(7) != (1 << 6)) {
+    std::memset(out, 0, 16 * 4);
+    return;
+  }
+
+  int e[2][4], p[2];
+  for (int c = 0; c < 4; c++) {
+    e[0][c] = reader.read(7);
+    e[1][c] = reader.read(7);
+  }
+  p[0] = reader.read(1);
+  p[1] = reader.read(1);
+
+  float palette[16][4];
+  bc7_palette(e, p, palette);
+
+  for (int i = 0; i < 16; i++) {
+    int index = reader.read(i == 0 ? 3 : 4);
+    for (int c = 0; c < 4; c++) {
+      out[i][c] = static_cast<unsigned char>(palette[index][c]);
+    }
+  }
+}
+
+void encode_block(const Block& block, CompressedImage::Format format, CompressedImage::Quality quality,
+                  unsigned char* out)
+{
+  switch (format) {
+    case ImageFile::BC1:
+      encode_color(block, quality, true, out);
+      break;
+    case ImageFile::BC3:
+      encode_channel(block, 3, quality, out);
+      encode_color(block, quality, false, out + 8);
+      break;
+    case ImageFile::BC4:
+      encode_channel(block, 0, quality, out);
+      break;
+    case ImageFile::BC5:
+      encode_channel(block, 0, quality, out);
+      encode_channel(block, 1, quality, out + 8);
+      break;
+    case ImageFile::BC7:
+      encode_bc7(block, quality, out);
+      break;
+    default:
+      assert(false);
+  }
+}
+
+void decode_block(const unsigned char* in, CompressedImage::Format format, unsigned char (*out)[4])
+{
+  switch (format) {
+    case ImageFile::BC1:
+      decode_color(in, false, out);
+      break;
+    case ImageFile::BC3:
+      decode_color(in + 8, true, out);
+      decode_channel(in, &out[0][3], 4);
+      break;
+    case ImageFile::BC4:
+      decode_channel(in, &out[0][0], 4);
+      break;
+    case ImageFile::BC5:
+      decode_channel(in, &out[0][0], 4);
+      decode_channel(in + 8, &out[0][1], 4);
+      break;
+    case ImageFile::BC7:
+      decode_bc7(in, out);
+      break;
+    default:
+      assert(false);
+  }
+}
+
+}  // namespace
+
+CompressedImage::CompressedImage() noexcept : m_format(ImageFile::NONE) {}
+
+CompressedImage::CompressedImage(const Image& image, Format format, Quality quality) : CompressedImage()
+{
+  if (!image.is_valid() || image.channels() > 4 || image.type() != Image::UNSIGNED_BYTE ||
+      block_size(format) == 0) {
+    return;
+  }
+
+  m_format = format;
+  add_level(image.data(), image.width(), image.height(), image.channels(), quality);
+}
+
+CompressedImage::CompressedImage(const MipChain& mips, Format format, Quality quality) : CompressedImage()
+{
+  if (!mips.is_valid() || block_size(format) == 0) {
+    return;
+  }
+
+  m_format = format;
+  for (int i = 0; i < mips.levels(); i++) {
+    add_level(mips.data(i), mips.width(i), mips.height(i), mips.channels(), quality);
+  }
+}
+
+void CompressedImage::add_level(const unsigned char* pixels, int width, int height, int channels, Quality quality)
+{
+  const int blocks_x = (width + 3) / 4;
+  const int blocks_y = (height + 3) / 4;
+  const std::size_t block = block_size(m_format);
+
+  Level level = {width, height, m_data.size(), static_cast<std::size_t>(blocks_x) * blocks_y * block};
+  m_data.resize(m_data.size() + level.size);
+  m_levels.push_back(level);
+
+  unsigned char* out = m_data.data() + level.offset;
+  const Format format = m_format;
+
+  ThreadPool::global().parallel_for(0, blocks_y, [&](int begin, int end) {
+    Block pixels_block;
+    for (int by = begin; by < end; by++) {
+      for (int bx = 0; bx < blocks_x; bx++) {
+        load_block(pixels, width, height, channels, bx, by, pixels_block);
+        encode_block(pixels_block, format, quality, out + (static_cast<std::size_t>(by) * blocks_x + bx) * block);
+      }
+    }
+  });
+}
+
+Image CompressedImage::decode(int level) const
+{
+  if (!is_valid()) {
+    return Image();
+  }
+
+  const Level& l = m_levels[level];
+  const int channels = this->channels();
+  const int blocks_x = (l.width + 3) / 4;
+  const int blocks_y = (l.height + 3) / 4;
+  const std::size_t block = block_size(m_format);
+
+  Image image(l.width, l.height, channels);
+  if (!image.is_valid()) {
+    return image;
+  }
+
+  const unsigned char* in = m_data.data() + l.offset;
+  unsigned char* pixels = image.data();
+
+  ThreadPool::global().parallel_for(0, blocks_y, [&](int begin, int end) {
+    unsigned char texels[16][4];
+    for (int by = begin; by < end; by++) {
+      for (int bx = 0; bx < blocks_x; bx++) {
+        decode_block(in + (static_cast<std::size_t>(by) * blocks_x + bx) * block, m_format, texels);
+        for (int i = 0; i < 16; i++) {
+          int x = bx * 4 + i % 4, y = by * 4 + i / 4;
+          if (x < l.width && y < l.height) {
+            std::memcpy(pixels + (static_cast<std::size_t>(y) * l.width + x) * channels, texels[i], channels);
+          }
+        }
+      }
+    }
+  });
+
+  return image;
+}
+
+CompressedImage::Format CompressedImage::format() const { return m_format; }
+
+int CompressedImage::channels() const
+{
+  switch (m_format) {
+    case ImageFile::BC4:
+      return 1;
+    case ImageFile::BC5:
+      return 2;
+    default:
+      return 4;
+  }
+}
+
+int CompressedImage::levels() const { return static_cast<int>(m_levels.size()); }
+
+int CompressedImage::width(int level) const { return m_levels[level].width; }
+
+int CompressedImage::height(int level) const { return m_levels[level].height; }
+
+const CompressedImage::Level& CompressedImage::level(int level) const { return m_levels[level]; }
+
+const unsigned char* CompressedImage::data(int level) const { return m_data.data() + m_levels[level].offset; }
+
+std::size_t CompressedImage::size_bytes() const { return m_data.size(); }
+
+bool CompressedImage::is_valid() const { return !m_levels.empty(); }
+
+std::size_t CompressedImage::block_size(Format format)
+{
+  switch (format) {
+    case ImageFile::BC1:
+    case ImageFile::BC4:
+      return 8;
+    case ImageFile::BC3:
+    case ImageFile::BC5:
+    case ImageFile::BC7:
+      return 16;
+    default:
+      return 0;
+  }
+}
+
+}  // namespace gfx
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "image.h"
+#include "image_file.h"
+#include "mipmap.h"
+
+namespace gfx
+{
+// BCn block compressed pixels ready for glCompressedTexImage2D, all levels live in one contiguous allocation
+class CompressedImage
+{
+ public:
+  using Format = ImageFile::Compression;
+
+  // fast fits the bounding box, normal the principal axis, slow also refines the endpoints by least squares
+  enum Quality { FAST, NORMAL, SLOW };
+
+  struct Level {
+    int width, height;
+    std::size_t offset, size;  // in bytes, relative to the start of the data
+  };
+
+  CompressedImage() noexcept;
+  // 8 bit pixels only, bc4 takes the red channel and bc5 red and green,
+  // missing channels read as 0 and missing alpha as 255 like they do on upload
+  CompressedImage(const Image& image, Format format, Quality quality = NORMAL);
+  CompressedImage(const MipChain& mips, Format format, Quality quality = NORMAL);
+
+  // back to 8 bit pixels, bc4 gives one channel, bc5 two and the others rgba
+  Image decode(int level = 0) const;
+
+  Format format() const;
+  int channels() const;  // of the decoded pixels
+  int levels() const;
+  int width(int level = 0) const;
+  int height(int level = 0) const;
+
+  const Level& level(int level) const;
+  const unsigned char* data(int level = 0) const;
+  std::size_t size_bytes() const;
+
+  bool is_valid() const;
+
+  // bytes per 4x4 block
+  static std::size_t block_size(Format format);
+
+ private:
+  std::vector<unsigned char> m_data;
+  std::vector<Level> m_levels;
+  Format m_format;
+
+  void add_level(const unsigned char* pixels, int width, int height, int channels, Quality quality);
+};
+}  // namespace gfx
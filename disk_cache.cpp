@@ -0,0 +1,120 @@
+#include "disk_cache.h"
+
+#include <atomic>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <system_error>
+#include <thread>
+
+#include "image_cache.h"
+#include "mapped_file.h"
+#include "mipmap.h"
+
+namespace gfx
+{
+
+namespace
+{
+
+// bump when the processing changes in a way that makes old entries wrong
+constexpr uint32_t CACHE_VERSION = 1;
+
+bool store(const Image& image, const DiskCache::Params& params, const std::filesystem::path& path)
+{
+  if (params.mipmaps) {
+    MipChain mips(image, params.srgb);
+    if (params.compression != ImageFile::NONE) {
+      return ImageFile::write(path, CompressedImage(mips, params.compression, params.quality));
+    }
+    return ImageFile::write(path, mips);
+  }
+
+  if (params.compression != ImageFile::NONE) {
+    return ImageFile::write(path, CompressedImage(image, params.compression, params.quality));
+  }
+  return ImageFile::write(path, image);
+}
+
+}  // namespace
+
+DiskCache::DiskCache(const std::filesystem::path& directory) : m_directory(directory)
+{
+  std::error_code error;
+  std::filesystem::create_directories(m_directory, error);
+}
+
+bool DiskCache::load(const std::filesystem::path& source, const Params& params, ImageFile& file) const
+{
+  MappedFile mapping(source);
+  if (!mapping.is_valid() || mapping.size() > INT32_MAX) {
+    return false;
+  }
+
+  const std::filesystem::path entry = entry_path(ImageCache::hash(mapping.data(), mapping.size()), params);
+
+  if (file.load(entry)) {
+    return true;
+  }
+
+  Image image(mapping.data(), static_cast<int>(mapping.size()), params.channels);
+  if (!image.is_valid()) {
+    return false;
+  }
+  if (params.flip_vertically) {
+    image.flip_vertically();
+  }
+
+  // unique per writer, the rename makes the entry appear at once
+  static std::atomic<unsigned> counter{0};
+  std::filesystem::path temporary = entry;
+  temporary += "." + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id())) + "." +
+               std::to_string(std::chrono::steady_clock::now().time_since_epoch().count()) + "." +
+               std::to_string(counter++) + ".tmp";
+
+  std::error_code error;
+  if (!store(image, params, temporary)) {
+    std::filesystem::remove(temporary, error);
+    return false;
+  }
+
+  // fails when another writer's entry is already mapped somewhere, theirs is just as good
+  std::filesystem::rename(temporary, entry, error);
+  if (error) {
+    std::filesystem::remove(temporary, error);
+  }
+
+  return file.load(entry);
+}
+
+void DiskCache::clear() const
+{
+  std::error_code error;
+  for (const auto& item : std::filesystem::directory_iterator(m_directory, error)) {
+    if (item.path().extension() == ".gfximg") {
+      std::filesystem::remove(item.path(), error);
+    }
+  }
+}
+
+const std::filesystem::path& DiskCache::directory() const { return m_directory; }
+
+std::filesystem::path DiskCache::entry_path(uint64_t source_hash, const Params& params) const
+{
+  const uint32_t values[] = {CACHE_VERSION,
+                             ImageFile::VERSION,
+                             params.flip_vertically,
+                             static_cast<uint32_t>(params.channels),
+                             params.mipmaps,
+                             params.srgb,
+                             params.compression,
+                             params.compression != ImageFile::NONE ? static_cast<uint32_t>(params.quality) : 0u};
+
+  const uint64_t params_hash = ImageCache::hash(reinterpret_cast<const unsigned char*>(values), sizeof(values));
+
+  char name[64];
+  std::snprintf(name, sizeof(name), "%016" PRIx64 "-%08" PRIx64 ".gfximg", source_hash, params_hash & 0xffffffffu);
+  return m_directory / name;
+}
+
+}  // namespace gfx
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+
+#include "block_compression.h"
+#include "image.h"
+#include "image_file.h"
+
+namespace gfx
+{
+// directory of processed textures stored as .gfximg, a warm start maps the stored file instead of decoding,
+// mipmapping and compressing the source again
+//
+// entries are named after a hash of the source bytes and the processing parameters, an edited source or other
+// parameters simply miss. entries are written to a temporary name first, readers never see a partial file
+class DiskCache
+{
+ public:
+  struct Params {
+    bool flip_vertically = false;
+    int channels = Image::DEFAULT_CHANNELS;
+    bool mipmaps = true;
+    bool srgb = true;  // average color channels of the mip levels in linear space
+    ImageFile::Compression compression = ImageFile::NONE;
+    CompressedImage::Quality quality = CompressedImage::NORMAL;
+  };
+
+  explicit DiskCache(const std::filesystem::path& directory);
+
+  // maps the entry for source into file, on a miss the source is processed and stored first
+  bool load(const std::filesystem::path& source, const Params& params, ImageFile& file) const;
+
+  // removes every entry
+  void clear() const;
+
+  const std::filesystem::path& directory() const;
+
+ private:
+  std::filesystem::path m_directory;
+
+  std::filesystem::path entry_path(uint64_t source_hash, const Params& params) const;
+};
+}  // namespace gfx
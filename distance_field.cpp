@@ -0,0 +1,196 @@
+#include "distance_field.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+#include "image_convert.h"
+#include "image_rows.h"
+#include "thread_pool.h"
+
+namespace gfx
+{
+
+namespace
+{
+
+// squared distances are whole numbers, up to this size they fit 32 bits, INF marks lines without a single feature pixel
+constexpr int MAX_SIZE = 32767;
+constexpr int32_t INF = std::numeric_limits<int32_t>::max();
+
+// columns gathered per chunk, so the column pass reads whole cache lines instead of one value per row
+constexpr int COLUMN_BLOCK = 16;
+
+// distance along a row to the closest pixel with inside == feature, squared
+void row_distances(const unsigned char* inside, unsigned char feature, int32_t* out, int width)
+{
+  int last = -1;
+  for (int x = 0; x < width; x++) {
+    if (inside[x] == feature) last = x;
+    out[x] = last < 0 ? INF : x - last;
+  }
+
+  last = -1;
+  for (int x = width - 1; x >= 0; x--) {
+    if (inside[x] == feature) last = x;
+    if (last >= 0) out[x] = std::min(out[x], last - x);
+    if (out[x] != INF) out[x] *= out[x];
+  }
+}
+
+// 1d squared distance transform, the lower envelope of the parabolas rooted at every finite f[q]
+void transform_line(const int32_t* f, int32_t* d, int n, int* v, double* z)
+{
+  int k = -1;
+  for (int q = 0; q < n; q++) {
+    if (f[q] == INF) continue;
+
+    double s = 0.0;
+    while (k >= 0) {
+      const int p = v[k];
+      s = static_cast<double>((f[q] + static_cast<int64_t>(q) * q) - (f[p] + static_cast<int64_t>(p) * p)) /
+          (2.0 * (q - p));
+      if (s > z[k]) break;
+      k--;
+    }
+
+    k++;
+    v[k] = q;
+    z[k] = k == 0 ? -std::numeric_limits<double>::infinity() : s;
+  }
+
+  if (k < 0) {
+    std::fill(d, d + n, INF);
+    return;
+  }
+
+  const int last = k;
+  k = 0;
+  for (int q = 0; q < n; q++) {
+    while (k < last && z[k + 1] < q) k++;
+    const int dq = q - v[k];
+    d[q] = dq * dq + f[v[k]];
+  }
+}
+
+// column pass of one transform, in place
+void transform_columns(std::vector<int32_t>& grid, int width, int height)
+{
+  const int blocks = (width + COLUMN_BLOCK - 1) / COLUMN_BLOCK;
+
+  ThreadPool::global().parallel_for(0, blocks, [&](int begin, int end) {
+    std::vector<int32_t> block(static_cast<std::size_t>(height) * COLUMN_BLOCK);
+    std::vector<int32_t> f(height), d(height);
+    std::vector<int> v(height);
+    std::vector<double> z(height);
+
+    for (int b = begin; b < end; b++) {
+      const int x0 = b * COLUMN_BLOCK;
+      const int columns = std::min(COLUMN_BLOCK, width - x0);
+
+      for (int y = 0; y < height; y++) {
+        std::memcpy(block.data() + y * COLUMN_BLOCK, grid.data() + static_cast<std::size_t>(y) * width + x0,
+                    columns * sizeof(int32_t));
+      }
+
+      for (int c = 0; c < columns; c++) {
+        for (int y = 0; y < height; y++) f[y] = block[y * COLUMN_BLOCK + c];
+        transform_line(f.data(), d.data(), height, v.data(), z.data());
+        for (int y = 0; y < height; y++) block[y * COLUMN_BLOCK + c] = d[y];
+      }
+
+      for (int y = 0; y < height; y++) {
+        std::memcpy(grid.data() + static_cast<std::size_t>(y) * width + x0, block.data() + y * COLUMN_BLOCK,
+                    columns * sizeof(int32_t));
+      }
+    }
+  });
+}
+
+}  // namespace
+
+Image distance_field(const ImageView& mask, float spread, Image::Type type, unsigned char threshold)
+{
+  if (!mask.is_valid() || mask.type() != Image::UNSIGNED_BYTE || spread <= 0.0f || mask.width() > MAX_SIZE ||
+      mask.height() > MAX_SIZE) {
+    return Image();
+  }
+
+  const int width = mask.width(), height = mask.height(), channels = mask.channels();
+  const int channel = (channels == 2 || channels == 4) ? channels - 1 : 0;
+  const std::size_t count = static_cast<std::size_t>(width) * height;
+  const int grain = detail::row_grain(width);
+
+  Image result(width, height, 1, type);
+  if (!result.is_valid()) {
+    return result;
+  }
+
+  // squared distance of every pixel to the closest inside and to the closest outside pixel,
+  // a pixel is inside exactly when its distance to the inside is 0
+  std::vector<int32_t> to_inside(count), to_outside(count);
+
+  ThreadPool::global().parallel_for(
+      0, height,
+      [&](int begin, int end) {
+        std::vector<unsigned char> inside(width);
+        for (int y = begin; y < end; y++) {
+          const std::size_t offset = static_cast<std::size_t>(y) * width;
+          const unsigned char* row = mask.row(y);
+          for (int x = 0; x < width; x++) {
+            inside[x] = row[x * channels + channel] >= threshold;
+          }
+          row_distances(inside.data(), 1, to_inside.data() + offset, width);
+          row_distances(inside.data(), 0, to_outside.data() + offset, width);
+        }
+      },
+      grain);
+
+  transform_columns(to_inside, width, height);
+  transform_columns(to_outside, width, height);
+
+  const float diagonal = std::sqrt(static_cast<float>(width) * width + static_cast<float>(height) * height);
+  const float scale = 0.5f / spread;
+  const std::size_t stride = static_cast<std::size_t>(width) * result.bytes_per_pixel();
+
+  ThreadPool::global().parallel_for(
+      0, height,
+      [&](int begin, int end) {
+        std::vector<float> distances(width);
+        for (int y = begin; y < end; y++) {
+          const std::size_t offset = static_cast<std::size_t>(y) * width;
+          for (int x = 0; x < width; x++) {
+            const bool in = to_inside[offset + x] == 0;
+            const int32_t d2 = in ? to_outside[offset + x] : to_inside[offset + x];
+            const float d = d2 == INF ? diagonal : std::sqrt(static_cast<float>(d2)) - 0.5f;
+            distances[x] = in ? d : -d;
+          }
+
+          unsigned char* out = result.data() + y * stride;
+          switch (type) {
+            case Image::HALF_FLOAT:
+              float_to_half(distances.data(), reinterpret_cast<uint16_t*>(out), width);
+              break;
+            case Image::FLOAT:
+              std::memcpy(out, distances.data(), width * sizeof(float));
+              break;
+            case Image::UNSIGNED_SHORT:
+              for (float& d : distances) d = d * scale + 0.5f;
+              float_to_unorm16(distances.data(), reinterpret_cast<uint16_t*>(out), width);
+              break;
+            default:
+              for (float& d : distances) d = d * scale + 0.5f;
+              float_to_unorm8(distances.data(), out, width);
+              break;
+          }
+        }
+      },
+      grain);
+
+  return result;
+}
+
+}  // namespace gfx
@@ -0,0 +1,20 @@
+#pragma once
+
+#include "image.h"
+#include "image_view.h"
+
+namespace gfx
+{
+// single channel signed distance field of an 8 bit mask, positive inside. a pixel is inside when its alpha, or its
+// grey value for images without alpha, is at least threshold. distances are exact euclidean distances between pixel
+// centers, shifted by half a pixel so the edge between an inside and an outside pixel sits at 0
+//
+// 8 and 16 bit output maps [-spread, spread] pixels to the full range with the edge in the middle, half float and
+// float output hold the distance in pixels. without any inside or outside pixels every pixel is the image diagonal
+// away from the edge
+//
+// linear time separable transform (Felzenszwalb and Huttenlocher), rows and then blocks of columns are split across
+// the shared thread pool
+Image distance_field(const ImageView& mask, float spread = 8.0f, Image::Type type = Image::UNSIGNED_BYTE,
+                     unsigned char threshold = 128);
+}  // namespace gfx
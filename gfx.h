@@ -1,6 +1,25 @@
 #pragma once
+#include "atlas.h"
+#include "block_compression.h"
 #include "camera.h"
+#include "disk_cache.h"
+#include "distance_field.h"
 #include "gl.h"
 #include "image.h"
+#include "image_allocator.h"
+#include "image_cache.h"
+#include "image_compare.h"
+#include "image_convert.h"
+#include "image_file.h"
+#include "image_filter.h"
+#include "image_stats.h"
+#include "image_stream.h"
+#include "image_view.h"
+#include "image_writer.h"
+#include "mipmap.h"
+#include "sampler.h"
+#include "summed_area_table.h"
+#include "tiled_image.h"
 #include "transform.h"
+#include "typed_image.h"
 #include "util.h"
@@ -117,10 +117,30 @@ bool ShaderProgram::load_cs()
     return false;
   }
 
-  GLuint compute_shader = create_shader(GL_COMPUTE_SHADER, shader_source);
+  bool loaded = link_compute(shader_source);
 
   free(shader_source);
 
+  return loaded;
+}
+
+std::unique_ptr<ShaderProgram> ShaderProgram::compute_from_source(const std::string& source)
+{
+  std::unique_ptr<ShaderProgram> program(new ShaderProgram());
+  if (!program->link_compute(source.c_str())) {
+    return nullptr;
+  }
+  return program;
+}
+
+bool ShaderProgram::link_compute(const char* source)
+{
+  GLuint compute_shader = create_shader(GL_COMPUTE_SHADER, source);
+
+  if (compute_shader == 0) {
+    return false;
+  }
+
   int loaded;
   char log[512];
 
@@ -129,8 +149,9 @@ bool ShaderProgram::load_cs()
   glLinkProgram(id);
   glGetProgramiv(id, GL_LINK_STATUS, &loaded);
   if (!loaded) {
-    glGetProgramInfoLog(m_id, 512, NULL, log);
+    glGetProgramInfoLog(id, 512, NULL, log);
     std::cerr << "Error:\n" << log;
+    glDeleteProgram(id);
     id = 0;
   }
 
@@ -275,11 +296,46 @@ Texture::Texture(const Image& image, const Params& params) : Texture()
   set_parameter(GL_TEXTURE_MIN_FILTER, params.min_filter);
   set_parameter(GL_TEXTURE_MAG_FILTER, params.mag_filter);
 
-  glTexImage2D(GL_TEXTURE_2D, 0, image.format(), image.width(), image.height(), 0, image.format(), GL_UNSIGNED_BYTE,
-               image.data());
+  set_image(image);
   glGenerateMipmap(GL_TEXTURE_2D);
 }
 
+Texture::Texture(const MipChain& mips, const Params& params) : Texture()
+{
+  glBindTexture(GL_TEXTURE_2D, m_id);
+
+  set_parameter(GL_TEXTURE_WRAP_S, params.wrap);
+  set_parameter(GL_TEXTURE_WRAP_T, params.wrap);
+  set_parameter(GL_TEXTURE_MIN_FILTER, params.min_filter);
+  set_parameter(GL_TEXTURE_MAG_FILTER, params.mag_filter);
+
+  set_image(mips);
+}
+
+Texture::Texture(const ImageFile& file, const Params& params) : Texture()
+{
+  glBindTexture(GL_TEXTURE_2D, m_id);
+
+  set_parameter(GL_TEXTURE_WRAP_S, params.wrap);
+  set_parameter(GL_TEXTURE_WRAP_T, params.wrap);
+  set_parameter(GL_TEXTURE_MIN_FILTER, params.min_filter);
+  set_parameter(GL_TEXTURE_MAG_FILTER, params.mag_filter);
+
+  set_image(file);
+}
+
+Texture::Texture(const CompressedImage& image, const Params& params) : Texture()
+{
+  glBindTexture(GL_TEXTURE_2D, m_id);
+
+  set_parameter(GL_TEXTURE_WRAP_S, params.wrap);
+  set_parameter(GL_TEXTURE_WRAP_T, params.wrap);
+  set_parameter(GL_TEXTURE_MIN_FILTER, params.min_filter);
+  set_parameter(GL_TEXTURE_MAG_FILTER, params.mag_filter);
+
+  set_image(image);
+}
+
 void Texture::bind(GLuint active_texture) const
 {
   glActiveTexture(GL_TEXTURE0 + active_texture);
@@ -298,8 +354,99 @@ void Texture::set_parameter(GLenum pname, const GLfloat* param) { glTexParameter
 
 void Texture::set_image(const Image& image)
 {
-  glTexImage2D(GL_TEXTURE_2D, 0, image.format(), image.width(), image.height(), 0, image.format(), GL_UNSIGNED_BYTE,
-               image.data());
+  // rows are tightly packed, odd widths of 8 bit red and rgb images are the usual case that is not 4 byte aligned
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+  glTexImage2D(GL_TEXTURE_2D, 0, image.internal_format(), image.width(), image.height(), 0, image.format(),
+               image.type(), image.data());
+
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+}
+
+void Texture::set_image(const MipChain& mips)
+{
+  if (!mips.is_valid()) {
+    return;
+  }
+
+  // levels are tightly packed, rows of odd sized levels are not 4 byte aligned
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  set_parameter(GL_TEXTURE_BASE_LEVEL, 0);
+  set_parameter(GL_TEXTURE_MAX_LEVEL, mips.levels() - 1);
+
+  for (int level = 0; level < mips.levels(); level++) {
+    glTexImage2D(GL_TEXTURE_2D, level, mips.format(), mips.width(level), mips.height(level), 0, mips.format(),
+                 GL_UNSIGNED_BYTE, mips.data(level));
+  }
+
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+}
+
+void Texture::set_image(const ImageFile& file)
+{
+  if (!file.is_valid()) {
+    return;
+  }
+
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  set_parameter(GL_TEXTURE_BASE_LEVEL, 0);
+  set_parameter(GL_TEXTURE_MAX_LEVEL, file.levels() - 1);
+
+  // level data points straight into the mapped file
+  for (int i = 0; i < file.levels(); i++) {
+    const ImageFile::Level& level = file.level(i);
+    if (file.compression() == ImageFile::NONE) {
+      glTexImage2D(GL_TEXTURE_2D, i, Image::internal_format(file.channels(), file.type()), level.width, level.height, 0,
+                   file.format(), file.type(), level.data);
+    } else {
+      glCompressedTexImage2D(GL_TEXTURE_2D, i, file.compression(), level.width, level.height, 0,
+                             static_cast<GLsizei>(level.size), level.data);
+    }
+  }
+
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+}
+
+void Texture::set_image(const CompressedImage& image)
+{
+  if (!image.is_valid()) {
+    return;
+  }
+
+  set_parameter(GL_TEXTURE_BASE_LEVEL, 0);
+  set_parameter(GL_TEXTURE_MAX_LEVEL, image.levels() - 1);
+
+  for (int i = 0; i < image.levels(); i++) {
+    glCompressedTexImage2D(GL_TEXTURE_2D, i, image.format(), image.width(i), image.height(i), 0,
+                           static_cast<GLsizei>(image.level(i).size), image.data(i));
+  }
+}
+
+void Texture::allocate(int width, int height, int channels, Image::Type type)
+{
+  static const Image::Format formats[] = {Image::RED, Image::RG, Image::RGB, Image::RGBA};
+  if (channels < 1 || channels > 4) {
+    return;
+  }
+
+  glTexImage2D(GL_TEXTURE_2D, 0, Image::internal_format(channels, type), width, height, 0, formats[channels - 1], type,
+               nullptr);
+}
+
+void Texture::set_sub_image(const ImageView& view, int x, int y)
+{
+  if (!view.is_valid()) {
+    return;
+  }
+
+  // the view's rows are uploaded in place, GL skips the rest of each stride
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  glPixelStorei(GL_UNPACK_ROW_LENGTH, static_cast<GLint>(view.stride() / view.bytes_per_pixel()));
+
+  glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, view.width(), view.height(), view.format(), view.type(), view.data());
+
+  glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
 }
 
 void Texture::generate_mipmap() { glGenerateMipmap(GL_TEXTURE_2D); }
@@ -314,6 +461,106 @@ std::unique_ptr<Texture> Texture::load(const std::string& path, const Params& pa
 
 std::unique_ptr<Texture> Texture::load(const std::string& path) { return Texture::load(path, {}); }
 
+namespace
+{
+
+const int HISTOGRAM_GROUP_SIZE = 16;
+const int HISTOGRAM_MAX_BINS = 1024;
+
+// bins are cleared and flushed by all 256 invocations of a group, empty bins are skipped when flushing
+const char* HISTOGRAM_SHADER = R"(#version 430
+layout(local_size_x = 16, local_size_y = 16) in;
+
+layout(std430, binding = 0) buffer Counts { uint counts[]; };
+
+uniform sampler2D image;
+uniform int width;
+uniform int height;
+uniform int channels;
+uniform int bins;
+uniform float min_value;
+uniform float scale;
+
+shared uint local_counts[4 * 1024];
+
+void main()
+{
+  uint total = uint(bins * channels);
+  for (uint i = gl_LocalInvocationIndex; i < total; i += 256u) {
+    local_counts[i] = 0u;
+  }
+  barrier();
+
+  ivec2 p = ivec2(gl_GlobalInvocationID.xy);
+  if (p.x < width && p.y < height) {
+    vec4 value = texelFetch(image, p, 0);
+    for (int c = 0; c < channels; c++) {
+      if (isnan(value[c])) continue;
+      int bin = int(clamp((value[c] - min_value) * scale, 0.0, float(bins - 1)));
+      atomicAdd(local_counts[c * bins + bin], 1u);
+    }
+  }
+  barrier();
+
+  for (uint i = gl_LocalInvocationIndex; i < total; i += 256u) {
+    if (local_counts[i] != 0u) {
+      atomicAdd(counts[i], local_counts[i]);
+    }
+  }
+}
+)";
+
+}  // namespace
+
+Histogram::Histogram(int bins) : m_bins(bins)
+{
+  if (bins >= 1 && bins <= HISTOGRAM_MAX_BINS) {
+    m_program = ShaderProgram::compute_from_source(HISTOGRAM_SHADER);
+  }
+}
+
+bool Histogram::is_valid() const { return m_program != nullptr; }
+
+int Histogram::bins() const { return m_bins; }
+
+std::vector<uint64_t> Histogram::compute(const Texture& texture, int width, int height, int channels, float min_value,
+                                         float max_value)
+{
+  if (!is_valid() || width <= 0 || height <= 0 || channels < 1 || channels > 4 || !(min_value < max_value)) {
+    return {};
+  }
+
+  // 32 bit counters, enough for any texture gl can allocate
+  const std::size_t size = static_cast<std::size_t>(m_bins) * channels;
+  std::vector<GLuint> counts(size, 0);
+
+  m_counts.bind();
+  m_counts.buffer_data(counts.data(), Buffer::size_bytes(counts), GL_DYNAMIC_READ);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, m_counts.id());
+
+  texture.bind(0);
+  m_program->bind();
+  m_program->set_uniform("image", 0);
+  m_program->set_uniform("width", width);
+  m_program->set_uniform("height", height);
+  m_program->set_uniform("channels", channels);
+  m_program->set_uniform("bins", m_bins);
+  m_program->set_uniform("min_value", min_value);
+  m_program->set_uniform("scale", static_cast<float>(m_bins) / (max_value - min_value));
+
+  glDispatchCompute((width + HISTOGRAM_GROUP_SIZE - 1) / HISTOGRAM_GROUP_SIZE,
+                    (height + HISTOGRAM_GROUP_SIZE - 1) / HISTOGRAM_GROUP_SIZE, 1);
+  glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+
+  glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, Buffer::size_bytes(counts), counts.data());
+
+  m_program->unbind();
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, 0);
+  m_counts.unbind();
+
+  return std::vector<uint64_t>(counts.begin(), counts.end());
+}
+
 #if 0
 std::unique_ptr<CubemapTexture> CubemapTexture::load(const std::vector<std::string>& paths)
 {
@@ -10,7 +10,11 @@
 #include <memory>
 #include <vector>
 
+#include "block_compression.h"
 #include "image.h"
+#include "image_file.h"
+#include "image_view.h"
+#include "mipmap.h"
 
 #define DEBUG_OPENGL 1
 
@@ -152,9 +156,13 @@ class ShaderProgram : public Object
   void set_uniform(const std::string& name, const glm::mat4& value) const;
   static std::string from_file(const std::filesystem::path& path);
   static char* read_from_file_and_handle_includes(const std::filesystem::path& path);
+  // compute program from glsl source instead of a file, nullptr if it does not compile or link
+  static std::unique_ptr<ShaderProgram> compute_from_source(const std::string& source);
 
  private:
   std::string m_vertex_shader_path, m_fragment_shader_path, m_compute_shader_path;
+  ShaderProgram() = default;
+  bool link_compute(const char* source);
   GLuint create_shader(GLenum shader_type, const char* source);
   GLuint create_program(GLuint s0, GLuint s1);
 };
@@ -171,6 +179,9 @@ struct Texture : public Object {
   ~Texture() { glDeleteTextures(1, &m_id); }
   Texture(const Image& image);
   Texture(const Image& image, const Params& params);
+  Texture(const MipChain& mips, const Params& params);
+  Texture(const ImageFile& file, const Params& params);
+  Texture(const CompressedImage& image, const Params& params);
   Texture(Texture&& other) noexcept : Object(std::move(other)) {}
   Texture& operator=(Texture&& other) noexcept
   {
@@ -186,12 +197,41 @@ struct Texture : public Object {
   void set_parameter(GLenum pname, GLint param);
   void set_parameter(GLenum pname, GLfloat param);
   void set_parameter(GLenum pname, const GLfloat* param);
+  // 16 bit, half float and float images get a sized internal format, e.g. GL_RGBA16F for rgba half floats
   void set_image(const Image& image);
+  void set_image(const MipChain& mips);
+  void set_image(const ImageFile& file);
+  void set_image(const CompressedImage& image);
+  // storage for level 0 without uploading anything, fill it with set_sub_image
+  void allocate(int width, int height, int channels, Image::Type type = Image::UNSIGNED_BYTE);
+  // upload view to the region starting at x, y of level 0, the texture has to be allocated already
+  void set_sub_image(const ImageView& view, int x, int y);
   void generate_mipmap();
   static std::unique_ptr<Texture> load(const std::string& path, const Params& params);
   static std::unique_ptr<Texture> load(const std::string& path);
 };
 
+// per channel histogram of a texture in a compute shader, the gpu counterpart of gfx::histogram with the same bin
+// layout and rounding. every work group counts 16x16 texels in shared memory and adds its bins to a storage buffer
+// at binding 0 once. the texture is read with texelFetch from level 0, 8 and 16 bit textures therefore count their
+// normalized values. needs opengl 4.3
+class Histogram
+{
+ public:
+  explicit Histogram(int bins = 256);  // at most 1024 bins
+  bool is_valid() const;
+  int bins() const;
+
+  // binds the texture to unit 0, blocks until the counts are read back. empty on failure
+  std::vector<uint64_t> compute(const Texture& texture, int width, int height, int channels, float min_value = 0.0f,
+                                float max_value = 1.0f);
+
+ private:
+  int m_bins;
+  std::unique_ptr<ShaderProgram> m_program;
+  ShaderStorageBuffer m_counts;
+};
+
 #if 0
 struct CubemapTexture : public Texture {
   CubemapTexture() : Texture(GL_TEXTURE_CUBE_MAP) {}
@@ -1,37 +1,544 @@
 #include "image.h"
 
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
 #include <iostream>
 #include <utility>
 #include <vector>
 
+#include "image_allocator.h"
+#include "image_convert.h"
+#include "image_rows.h"
+#include "image_stream.h"
+#include "image_view.h"
+
+#define STBI_MALLOC(size)                  gfx::detail::image_malloc(size)
+#define STBI_REALLOC_SIZED(ptr, old, size) gfx::detail::image_realloc(ptr, old, size)
+#define STBI_FREE(ptr)                     gfx::detail::image_free(ptr)
+
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb/stb_image.h"
 
 #define STB_IMAGE_WRITE_IMPLEMENTATION
 #include "stb/stb_image_write.h"
 
-constexpr int DEFAULT_IMAGE_CHANNELS = 3;
+#include "mapped_file.h"
+#include "simd.h"
+#include "thread_pool.h"
 
 namespace gfx
 {
 
-Image::Image() noexcept : m_data(nullptr), m_width(0), m_height(0), m_channels(0) {}
+namespace
+{
+
+using detail::load_row;
+using detail::max_ps;
+using detail::min_ps;
+using detail::row_grain;
+using detail::store_row;
+using detail::type_size;
+
+static_assert(sizeof(glm::vec2) == 2 * sizeof(float), "sample_batch expects tightly packed uvs");
+static_assert(sizeof(glm::u8vec4) == 4, "sample_batch expects tightly packed pixels");
+
+// beyond this a float has no fractional part left to wrap
+constexpr float MAX_REPEAT_UV = 65536.0f;
+
+inline int floor_to_int(float v)
+{
+  int i = static_cast<int>(v);
+  return i - (static_cast<float>(i) > v ? 1 : 0);
+}
+
+inline float repeat(float v)
+{
+  v = min_ps(max_ps(v, -MAX_REPEAT_UV), MAX_REPEAT_UV);
+  return v - static_cast<float>(floor_to_int(v));
+}
+
+// rows of large images are converted in parallel, small ones are not worth waking the pool for
+template <typename Body>
+void for_each_row(int height, std::size_t row_bytes, Body body)
+{
+  ThreadPool::global().parallel_for(
+      0, height,
+      [&](int begin, int end) {
+        for (int y = begin; y < end; y++) {
+          body(y);
+        }
+      },
+      row_grain(row_bytes));
+}
+
+void convert_row(const unsigned char* src, int src_channels, unsigned char* dst, int dst_channels,
+                 Image::Type type, std::size_t count)
+{
+  switch (type) {
+    case Image::UNSIGNED_SHORT:
+      convert_channels(reinterpret_cast<const uint16_t*>(src), src_channels, reinterpret_cast<uint16_t*>(dst),
+                       dst_channels, count);
+      break;
+    case Image::HALF_FLOAT: {
+      // alpha fill and luma weights only make sense on the values, not on the bits
+      std::vector<float> in(count * src_channels), out(count * dst_channels);
+      half_to_float(reinterpret_cast<const uint16_t*>(src), in.data(), in.size());
+      convert_channels(in.data(), src_channels, out.data(), dst_channels, count);
+      float_to_half(out.data(), reinterpret_cast<uint16_t*>(dst), out.size());
+      break;
+    }
+    case Image::FLOAT:
+      convert_channels(reinterpret_cast<const float*>(src), src_channels, reinterpret_cast<float*>(dst), dst_channels,
+                       count);
+      break;
+    default:
+      convert_channels(src, src_channels, dst, dst_channels, count);
+      break;
+  }
+}
+
+// pixels stb decoded as one type are converted into a second allocation of another type that replaces the first,
+// 8 and 16 bit values map to [0, 1] like Image::convert
+void* convert_pixels(void* data, Image::Type from, Image::Type to, int width, int height, int channels)
+{
+  const std::size_t values = static_cast<std::size_t>(width) * channels;
+  const std::size_t src_stride = values * type_size(from), dst_stride = values * type_size(to);
+
+  auto* pixels = static_cast<unsigned char*>(STBI_MALLOC(dst_stride * height));
+  if (pixels) {
+    const auto* src = static_cast<const unsigned char*>(data);
+    ThreadPool::global().parallel_for(
+        0, height,
+        [&](int begin, int end) {
+          std::vector<float> row(values);
+          for (int y = begin; y < end; y++) {
+            load_row(src + y * src_stride, from, row.data(), values);
+            store_row(row.data(), to, pixels + y * dst_stride, values);
+          }
+        },
+        row_grain(values));
+  }
+
+  stbi_image_free(data);
+  return pixels;
+}
+
+// float and half float images decode hdr files with stbi_loadf. everything else is decoded at its own bit depth and
+// normalized afterwards, stbi_loadf would go through 8 bit and apply a 2.2 gamma to it
+template <typename Load, typename Load16, typename LoadF>
+void* decode(Image::Type type, bool is_hdr, bool is_16_bit, int* width, int* height, int* channels, Load load,
+             Load16 load_16, LoadF load_f)
+{
+  int channels_in_file = 0;
+  Image::Type decoded = type;
+  void* data;
+
+  if (type == Image::UNSIGNED_SHORT) {
+    data = load_16(&channels_in_file);
+  } else if (type == Image::UNSIGNED_BYTE) {
+    data = load(&channels_in_file);
+  } else if (is_hdr) {
+    decoded = Image::FLOAT;
+    data = load_f(&channels_in_file);
+  } else if (is_16_bit) {
+    decoded = Image::UNSIGNED_SHORT;
+    data = load_16(&channels_in_file);
+  } else {
+    decoded = Image::UNSIGNED_BYTE;
+    data = load(&channels_in_file);
+  }
+
+  if (!data) {
+    return nullptr;
+  }
+
+  *channels = *channels ? *channels : channels_in_file;
+  return decoded == type ? data : convert_pixels(data, decoded, type, *width, *height, *channels);
+}
+
+// channels is 0 for the channel count of the file, on return it holds the actual count
+void* decode(const unsigned char* buffer, int len, int* width, int* height, int* channels, Image::Type type)
+{
+  const int desired = *channels;
+  return decode(
+      type, stbi_is_hdr_from_memory(buffer, len), stbi_is_16_bit_from_memory(buffer, len), width, height, channels,
+      [&](int* in_file) { return stbi_load_from_memory(buffer, len, width, height, in_file, desired); },
+      [&](int* in_file) { return stbi_load_16_from_memory(buffer, len, width, height, in_file, desired); },
+      [&](int* in_file) { return stbi_loadf_from_memory(buffer, len, width, height, in_file, desired); });
+}
+
+void* decode(const std::filesystem::path& path, int* width, int* height, int* channels, Image::Type type)
+{
+  const std::string filename = path.string();
+  const char* name = filename.c_str();
+  const int desired = *channels;
+  return decode(
+      type, stbi_is_hdr(name), stbi_is_16_bit(name), width, height, channels,
+      [&](int* in_file) { return stbi_load(name, width, height, in_file, desired); },
+      [&](int* in_file) { return stbi_load_16(name, width, height, in_file, desired); },
+      [&](int* in_file) { return stbi_loadf(name, width, height, in_file, desired); });
+}
+
+inline uint32_t fetch_texel(const unsigned char* texel, int channels)
+{
+  if (channels >= 4) {
+    uint32_t value;
+    std::memcpy(&value, texel, sizeof(value));
+    return value;
+  }
+
+  unsigned char rgba[4] = {0, 0, 0, 0};
+  for (int c = 0; c < channels; c++) {
+    rgba[c] = texel[c];
+  }
+  uint32_t value;
+  std::memcpy(&value, rgba, sizeof(value));
+  return value;
+}
+
+inline uint32_t lerp_texel(uint32_t a, uint32_t b, int w)
+{
+  uint32_t result = 0;
+  for (int c = 0; c < 4; c++) {
+    uint32_t ca = (a >> (8 * c)) & 0xff;
+    uint32_t cb = (b >> (8 * c)) & 0xff;
+    result |= ((ca * (256 - w) + cb * w + 128) >> 8) << (8 * c);
+  }
+  return result;
+}
+
+// precomputed per batch, coordinates are handled in 24.8 fixed point after the initial scale
+struct BatchSampler {
+  const unsigned char* data;
+  int width, height, channels;
+  float fwidth, fheight;  // width and height as floats
+  float max_x, max_y;     // last texel, for nearest sampling
+  float scale_x, scale_y; // width * 256, height * 256, for linear sampling
+  Image::Wrap wrap;
+
+  inline const unsigned char* texel(int x, int y) const
+  {
+    return data + (static_cast<std::size_t>(y) * width + x) * channels;
+  }
+
+  uint32_t nearest(glm::vec2 uv) const
+  {
+    if (wrap == Image::REPEAT) {
+      uv = glm::vec2(repeat(uv.x), repeat(uv.y));
+    }
+    int x = static_cast<int>(min_ps(max_ps(uv.x * fwidth, 0.0f), max_x));
+    int y = static_cast<int>(min_ps(max_ps(uv.y * fheight, 0.0f), max_y));
+    return fetch_texel(texel(x, y), channels);
+  }
+
+  uint32_t linear(glm::vec2 uv) const
+  {
+    if (wrap == Image::REPEAT) {
+      uv = glm::vec2(repeat(uv.x), repeat(uv.y));
+    }
+    int fx = static_cast<int>(min_ps(max_ps(uv.x * scale_x, 0.0f), scale_x)) - 128;
+    int fy = static_cast<int>(min_ps(max_ps(uv.y * scale_y, 0.0f), scale_y)) - 128;
+
+    int x0 = fx >> 8, y0 = fy >> 8;
+    int x1 = x0 + 1, y1 = y0 + 1;
+    int wx = fx & 0xff, wy = fy & 0xff;
+
+    if (wrap == Image::REPEAT) {
+      x0 += x0 < 0 ? width : 0;
+      y0 += y0 < 0 ? height : 0;
+      x1 -= x1 >= width ? width : 0;
+      y1 -= y1 >= height ? height : 0;
+    } else {
+      x0 = x0 < 0 ? 0 : x0;
+      y0 = y0 < 0 ? 0 : y0;
+      x1 = x1 >= width ? width - 1 : x1;
+      y1 = y1 >= height ? height - 1 : y1;
+    }
+
+    uint32_t t = lerp_texel(fetch_texel(texel(x0, y0), channels), fetch_texel(texel(x1, y0), channels), wx);
+    uint32_t b = lerp_texel(fetch_texel(texel(x0, y1), channels), fetch_texel(texel(x1, y1), channels), wx);
+    return lerp_texel(t, b, wy);
+  }
+};
+
+#if defined(GFX_SSE2)
+
+inline __m128 max_ps(__m128 a, __m128 b) { return _mm_max_ps(a, b); }
+
+inline __m128 min_ps(__m128 a, __m128 b) { return _mm_min_ps(a, b); }
+
+inline __m128i floor_to_int(__m128 v)
+{
+  __m128i i = _mm_cvttps_epi32(v);
+  __m128 too_large = _mm_cmpgt_ps(_mm_cvtepi32_ps(i), v);
+  return _mm_add_epi32(i, _mm_castps_si128(too_large));
+}
+
+inline __m128 repeat(__m128 v)
+{
+  v = _mm_min_ps(_mm_max_ps(v, _mm_set1_ps(-MAX_REPEAT_UV)), _mm_set1_ps(MAX_REPEAT_UV));
+  return _mm_sub_ps(v, _mm_cvtepi32_ps(floor_to_int(v)));
+}
+
+// (a * (256 - w) + b * w + 128) >> 8 for four rgba8 pixels, w holds one weight per pixel
+inline __m128i lerp_texels(__m128i a, __m128i b, __m128i w)
+{
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i one = _mm_set1_epi16(256);
+  const __m128i half = _mm_set1_epi16(128);
+
+  __m128i w16 = _mm_packs_epi32(w, w);
+  w16 = _mm_unpacklo_epi16(w16, w16);
+  __m128i w_lo = _mm_unpacklo_epi32(w16, w16);
+  __m128i w_hi = _mm_unpackhi_epi32(w16, w16);
+
+  __m128i a_lo = _mm_mullo_epi16(_mm_unpacklo_epi8(a, zero), _mm_sub_epi16(one, w_lo));
+  __m128i a_hi = _mm_mullo_epi16(_mm_unpackhi_epi8(a, zero), _mm_sub_epi16(one, w_hi));
+  __m128i b_lo = _mm_mullo_epi16(_mm_unpacklo_epi8(b, zero), w_lo);
+  __m128i b_hi = _mm_mullo_epi16(_mm_unpackhi_epi8(b, zero), w_hi);
+
+  __m128i lo = _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(a_lo, b_lo), half), 8);
+  __m128i hi = _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(a_hi, b_hi), half), 8);
+  return _mm_packus_epi16(lo, hi);
+}
+
+inline __m128i gather_texels(const BatchSampler& s, const int* x, const int* y)
+{
+  return _mm_setr_epi32(static_cast<int>(fetch_texel(s.texel(x[0], y[0]), s.channels)),
+                        static_cast<int>(fetch_texel(s.texel(x[1], y[1]), s.channels)),
+                        static_cast<int>(fetch_texel(s.texel(x[2], y[2]), s.channels)),
+                        static_cast<int>(fetch_texel(s.texel(x[3], y[3]), s.channels)));
+}
+
+// four uvs per iteration, returns the number of uvs processed
+std::size_t sample_nearest_sse2(const BatchSampler& s, const glm::vec2* uvs, glm::u8vec4* out, std::size_t count)
+{
+  const __m128 fwidth = _mm_set1_ps(s.fwidth), fheight = _mm_set1_ps(s.fheight);
+  const __m128 max_x = _mm_set1_ps(s.max_x), max_y = _mm_set1_ps(s.max_y);
+  const __m128 zero = _mm_setzero_ps();
+
+  std::size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    __m128 a = _mm_loadu_ps(&uvs[i].x);
+    __m128 b = _mm_loadu_ps(&uvs[i + 2].x);
+    __m128 u = _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+    __m128 v = _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+
+    if (s.wrap == Image::REPEAT) {
+      u = repeat(u);
+      v = repeat(v);
+    }
+
+    __m128i xi = _mm_cvttps_epi32(min_ps(max_ps(_mm_mul_ps(u, fwidth), zero), max_x));
+    __m128i yi = _mm_cvttps_epi32(min_ps(max_ps(_mm_mul_ps(v, fheight), zero), max_y));
+
+    alignas(16) int x[4], y[4];
+    _mm_store_si128(reinterpret_cast<__m128i*>(x), xi);
+    _mm_store_si128(reinterpret_cast<__m128i*>(y), yi);
+
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(&out[i]), gather_texels(s, x, y));
+  }
+  return i;
+}
+
+std::size_t sample_linear_sse2(const BatchSampler& s, const glm::vec2* uvs, glm::u8vec4* out, std::size_t count)
+{
+  const __m128 scale_x = _mm_set1_ps(s.scale_x), scale_y = _mm_set1_ps(s.scale_y);
+  const __m128 zero = _mm_setzero_ps();
+  const __m128i half = _mm_set1_epi32(128), mask = _mm_set1_epi32(0xff), one = _mm_set1_epi32(1);
+  const __m128i width = _mm_set1_epi32(s.width), height = _mm_set1_epi32(s.height);
+  const __m128i max_x = _mm_set1_epi32(s.width - 1), max_y = _mm_set1_epi32(s.height - 1);
+  const __m128i izero = _mm_setzero_si128();
+
+  std::size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    __m128 a = _mm_loadu_ps(&uvs[i].x);
+    __m128 b = _mm_loadu_ps(&uvs[i + 2].x);
+    __m128 u = _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+    __m128 v = _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+
+    if (s.wrap == Image::REPEAT) {
+      u = repeat(u);
+      v = repeat(v);
+    }
+
+    __m128i fx = _mm_sub_epi32(_mm_cvttps_epi32(min_ps(max_ps(_mm_mul_ps(u, scale_x), zero), scale_x)), half);
+    __m128i fy = _mm_sub_epi32(_mm_cvttps_epi32(min_ps(max_ps(_mm_mul_ps(v, scale_y), zero), scale_y)), half);
+
+    __m128i x0 = _mm_srai_epi32(fx, 8), y0 = _mm_srai_epi32(fy, 8);
+    __m128i x1 = _mm_add_epi32(x0, one), y1 = _mm_add_epi32(y0, one);
+    __m128i wx = _mm_and_si128(fx, mask), wy = _mm_and_si128(fy, mask);
+
+    if (s.wrap == Image::REPEAT) {
+      x0 = _mm_add_epi32(x0, _mm_and_si128(_mm_cmplt_epi32(x0, izero), width));
+      y0 = _mm_add_epi32(y0, _mm_and_si128(_mm_cmplt_epi32(y0, izero), height));
+      x1 = _mm_sub_epi32(x1, _mm_andnot_si128(_mm_cmplt_epi32(x1, width), width));
+      y1 = _mm_sub_epi32(y1, _mm_andnot_si128(_mm_cmplt_epi32(y1, height), height));
+    } else {
+      // x0 >= -1 and x1 <= width, so a single step moves them back inside
+      x0 = _mm_sub_epi32(x0, _mm_cmplt_epi32(x0, izero));
+      y0 = _mm_sub_epi32(y0, _mm_cmplt_epi32(y0, izero));
+      x1 = _mm_add_epi32(x1, _mm_cmpgt_epi32(x1, max_x));
+      y1 = _mm_add_epi32(y1, _mm_cmpgt_epi32(y1, max_y));
+    }
+
+    alignas(16) int x[8], y[8];
+    _mm_store_si128(reinterpret_cast<__m128i*>(x), x0);
+    _mm_store_si128(reinterpret_cast<__m128i*>(x + 4), x1);
+    _mm_store_si128(reinterpret_cast<__m128i*>(y), y0);
+    _mm_store_si128(reinterpret_cast<__m128i*>(y + 4), y1);
+
+    const int xl[4] = {x[0], x[1], x[2], x[3]}, xr[4] = {x[4], x[5], x[6], x[7]};
+    const int yt[4] = {y[0], y[1], y[2], y[3]}, yb[4] = {y[4], y[5], y[6], y[7]};
+
+    __m128i t = lerp_texels(gather_texels(s, xl, yt), gather_texels(s, xr, yt), wx);
+    __m128i bottom = lerp_texels(gather_texels(s, xl, yb), gather_texels(s, xr, yb), wx);
+
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(&out[i]), lerp_texels(t, bottom, wy));
+  }
+  return i;
+}
+
+#endif
+
+#if defined(GFX_AVX2)
+
+inline __m256 repeat(__m256 v)
+{
+  v = _mm256_min_ps(_mm256_max_ps(v, _mm256_set1_ps(-MAX_REPEAT_UV)), _mm256_set1_ps(MAX_REPEAT_UV));
+  __m256i i = _mm256_cvttps_epi32(v);
+  __m256 too_large = _mm256_cmp_ps(_mm256_cvtepi32_ps(i), v, _CMP_GT_OQ);
+  i = _mm256_add_epi32(i, _mm256_castps_si256(too_large));
+  return _mm256_sub_ps(v, _mm256_cvtepi32_ps(i));
+}
+
+inline void load_uvs(const glm::vec2* uvs, __m256& u, __m256& v)
+{
+  __m256 a = _mm256_loadu_ps(&uvs[0].x);
+  __m256 b = _mm256_loadu_ps(&uvs[4].x);
+  // shuffle works per 128 bit lane, the permute restores the uv order
+  __m256 lu = _mm256_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+  __m256 lv = _mm256_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+  u = _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(lu), _MM_SHUFFLE(3, 1, 2, 0)));
+  v = _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(lv), _MM_SHUFFLE(3, 1, 2, 0)));
+}
+
+// rgba8 texels are fetched with a single gather, other channel counts fall back to scalar loads
+inline __m256i gather_texels(const BatchSampler& s, __m256i x, __m256i y)
+{
+  if (s.channels == 4) {
+    __m256i offset = _mm256_slli_epi32(_mm256_add_epi32(_mm256_mullo_epi32(y, _mm256_set1_epi32(s.width)), x), 2);
+    return _mm256_i32gather_epi32(reinterpret_cast<const int*>(s.data), offset, 1);
+  }
+
+  alignas(32) int xs[8], ys[8];
+  _mm256_store_si256(reinterpret_cast<__m256i*>(xs), x);
+  _mm256_store_si256(reinterpret_cast<__m256i*>(ys), y);
+  return _mm256_setr_m128i(gather_texels(s, xs, ys), gather_texels(s, xs + 4, ys + 4));
+}
+
+inline __m256i lerp_texels(__m256i a, __m256i b, __m256i w)
+{
+  __m128i lo = lerp_texels(_mm256_castsi256_si128(a), _mm256_castsi256_si128(b), _mm256_castsi256_si128(w));
+  __m128i hi = lerp_texels(_mm256_extracti128_si256(a, 1), _mm256_extracti128_si256(b, 1),
+                           _mm256_extracti128_si256(w, 1));
+  return _mm256_setr_m128i(lo, hi);
+}
+
+std::size_t sample_nearest_avx2(const BatchSampler& s, const glm::vec2* uvs, glm::u8vec4* out, std::size_t count)
+{
+  const __m256 fwidth = _mm256_set1_ps(s.fwidth), fheight = _mm256_set1_ps(s.fheight);
+  const __m256 max_x = _mm256_set1_ps(s.max_x), max_y = _mm256_set1_ps(s.max_y);
+  const __m256 zero = _mm256_setzero_ps();
+
+  std::size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    __m256 u, v;
+    load_uvs(&uvs[i], u, v);
+
+    if (s.wrap == Image::REPEAT) {
+      u = repeat(u);
+      v = repeat(v);
+    }
+
+    __m256i x = _mm256_cvttps_epi32(_mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(u, fwidth), zero), max_x));
+    __m256i y = _mm256_cvttps_epi32(_mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(v, fheight), zero), max_y));
+
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(&out[i]), gather_texels(s, x, y));
+  }
+  return i;
+}
+
+std::size_t sample_linear_avx2(const BatchSampler& s, const glm::vec2* uvs, glm::u8vec4* out, std::size_t count)
+{
+  const __m256 scale_x = _mm256_set1_ps(s.scale_x), scale_y = _mm256_set1_ps(s.scale_y);
+  const __m256 zero = _mm256_setzero_ps();
+  const __m256i half = _mm256_set1_epi32(128), mask = _mm256_set1_epi32(0xff), one = _mm256_set1_epi32(1);
+  const __m256i width = _mm256_set1_epi32(s.width), height = _mm256_set1_epi32(s.height);
+  const __m256i max_x = _mm256_set1_epi32(s.width - 1), max_y = _mm256_set1_epi32(s.height - 1);
+  const __m256i izero = _mm256_setzero_si256();
+
+  std::size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    __m256 u, v;
+    load_uvs(&uvs[i], u, v);
+
+    if (s.wrap == Image::REPEAT) {
+      u = repeat(u);
+      v = repeat(v);
+    }
+
+    __m256i fx = _mm256_sub_epi32(
+        _mm256_cvttps_epi32(_mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(u, scale_x), zero), scale_x)), half);
+    __m256i fy = _mm256_sub_epi32(
+        _mm256_cvttps_epi32(_mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(v, scale_y), zero), scale_y)), half);
+
+    __m256i x0 = _mm256_srai_epi32(fx, 8), y0 = _mm256_srai_epi32(fy, 8);
+    __m256i x1 = _mm256_add_epi32(x0, one), y1 = _mm256_add_epi32(y0, one);
+    __m256i wx = _mm256_and_si256(fx, mask), wy = _mm256_and_si256(fy, mask);
+
+    if (s.wrap == Image::REPEAT) {
+      x0 = _mm256_add_epi32(x0, _mm256_and_si256(_mm256_cmpgt_epi32(izero, x0), width));
+      y0 = _mm256_add_epi32(y0, _mm256_and_si256(_mm256_cmpgt_epi32(izero, y0), height));
+      x1 = _mm256_sub_epi32(x1, _mm256_and_si256(_mm256_cmpgt_epi32(x1, max_x), width));
+      y1 = _mm256_sub_epi32(y1, _mm256_and_si256(_mm256_cmpgt_epi32(y1, max_y), height));
+    } else {
+      x0 = _mm256_max_epi32(x0, izero);
+      y0 = _mm256_max_epi32(y0, izero);
+      x1 = _mm256_min_epi32(x1, max_x);
+      y1 = _mm256_min_epi32(y1, max_y);
+    }
+
+    __m256i t = lerp_texels(gather_texels(s, x0, y0), gather_texels(s, x1, y0), wx);
+    __m256i b = lerp_texels(gather_texels(s, x0, y1), gather_texels(s, x1, y1), wx);
+
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(&out[i]), lerp_texels(t, b, wy));
+  }
+  return i;
+}
+
+#endif
+
+}  // namespace
 
-Image::Image(int width, int height, int channels) noexcept
-    : m_data(nullptr), m_width(width), m_height(height), m_channels(channels)
+Image::Image() noexcept : m_data(nullptr), m_width(0), m_height(0), m_channels(0), m_type(UNSIGNED_BYTE) {}
+
+Image::Image(int width, int height, int channels, Type type) noexcept
+    : m_data(nullptr), m_width(width), m_height(height), m_channels(channels), m_type(type)
 {
-  int len = sizeof(*m_data) * width * height * channels;
+  std::size_t len = size_bytes();
   m_data = (unsigned char*)STBI_MALLOC(len);
   if (m_data) {
     std::memset(m_data, 0x0, len);
   }
 }
 
-Image::Image(const unsigned char* buffer, int len) noexcept : Image()
+Image::Image(const unsigned char* buffer, int len, int channels, Type type) noexcept : Image()
 {
-  int channels_in_file;
-  m_channels = DEFAULT_IMAGE_CHANNELS;
-  m_data = stbi_load_from_memory(buffer, len, &m_width, &m_height, &channels_in_file, m_channels);
+  m_channels = channels;
+  m_type = type;
+  m_data = static_cast<unsigned char*>(decode(buffer, len, &m_width, &m_height, &m_channels, m_type));
 }
 
 Image::Image(Image&& other) noexcept : Image() { *this = std::move(other); }
@@ -48,7 +555,7 @@ Image::~Image() noexcept { cleanup(); }
 
 void Image::cleanup()
 {
-  if (m_data) {
+  if (m_data && !m_owner) {
     stbi_image_free(m_data);
   }
   reset();
@@ -60,6 +567,8 @@ void Image::reset()
   m_width = 0;
   m_height = 0;
   m_channels = 0;
+  m_type = UNSIGNED_BYTE;
+  m_owner.reset();
 }
 
 void Image::swap(Image& other)
@@ -78,6 +587,9 @@ void Image::swap(Image& other)
   other.m_width = width;
   other.m_height = height;
   other.m_channels = channels;
+
+  std::swap(m_type, other.m_type);
+  m_owner.swap(other.m_owner);
 }
 
 unsigned char* Image::data() const { return m_data; }
@@ -88,6 +600,14 @@ int Image::height() const { return m_height; }
 
 int Image::channels() const { return m_channels; }
 
+Image::Type Image::type() const { return m_type; }
+
+int Image::bytes_per_channel() const { return type_size(m_type); }
+
+int Image::bytes_per_pixel() const { return m_channels * type_size(m_type); }
+
+std::size_t Image::size_bytes() const { return static_cast<std::size_t>(m_width) * m_height * bytes_per_pixel(); }
+
 bool Image::is_valid() const { return (m_data != nullptr) && (0 < m_width) && (0 < m_height) && (0 < m_channels); }
 
 Image::Format Image::format() const
@@ -97,84 +617,361 @@ Image::Format Image::format() const
   return formats[m_channels - 1];
 }
 
-bool Image::load(const std::filesystem::path& path, bool flip_vertically)
+GLint Image::internal_format() const { return internal_format(m_channels, m_type); }
+
+GLint Image::internal_format(int channels, Type type)
 {
-  int channels_in_file;
-  m_channels = DEFAULT_IMAGE_CHANNELS;
-  stbi_set_flip_vertically_on_load(flip_vertically);
-  m_data = stbi_load(path.string().c_str(), &m_width, &m_height, &channels_in_file, m_channels);
+  assert(1 <= channels && channels <= 4);
+  static GLint byte_formats[] = {GL_RED, GL_RG, GL_RGB, GL_RGBA};
+  static GLint short_formats[] = {GL_R16, GL_RG16, GL_RGB16, GL_RGBA16};
+  static GLint half_formats[] = {GL_R16F, GL_RG16F, GL_RGB16F, GL_RGBA16F};
+  static GLint float_formats[] = {GL_R32F, GL_RG32F, GL_RGB32F, GL_RGBA32F};
+
+  switch (type) {
+    case UNSIGNED_SHORT:
+      return short_formats[channels - 1];
+    case HALF_FLOAT:
+      return half_formats[channels - 1];
+    case FLOAT:
+      return float_formats[channels - 1];
+    default:
+      return byte_formats[channels - 1];
+  }
+}
+
+// flipping is done here instead of through stbi_set_flip_vertically_on_load, which is process wide
+// state and would race between loader threads
+bool Image::load(const std::filesystem::path& path, bool flip_vertically, int channels, Type type)
+{
+  cleanup();
+  m_channels = channels;
+  m_type = type;
+  m_data = static_cast<unsigned char*>(decode(path, &m_width, &m_height, &m_channels, m_type));
+  if (flip_vertically) {
+    this->flip_vertically();
+  }
   return is_valid();
 }
 
-bool Image::write_png(const std::filesystem::path& path) const
+bool Image::load_mapped(const std::filesystem::path& path, bool flip_vertically, int channels, Type type)
 {
-  if (!is_valid()) {
+  auto file = std::make_shared<MappedFile>(path);
+
+  if (!file->is_valid() || file->size() > INT32_MAX) {
+    *this = Image();
     return false;
   }
-  return stbi_write_png(path.string().c_str(), m_width, m_height, m_channels, m_data, m_width * m_channels) == 1;
+
+  int width, height, channels_in_file;
+  std::size_t offset = detail::parse_pnm_header(file->data(), file->size(), &width, &height, &channels_in_file);
+
+  if (offset != 0 && type == UNSIGNED_BYTE && (channels == NATIVE_CHANNELS || channels == channels_in_file)) {
+    // pnm pixels are packed rows, the same layout the decoder produces, so use them in place
+    Image image;
+    image.m_data = file->data() + offset;
+    image.m_width = width;
+    image.m_height = height;
+    image.m_channels = channels_in_file;
+    image.m_owner = std::move(file);
+    *this = std::move(image);
+  } else {
+    *this = Image(file->data(), static_cast<int>(file->size()), channels, type);
+  }
+
+  // pages of a mapped image are copied on write, so this is the one copy a flipped load needs
+  if (flip_vertically) {
+    this->flip_vertically();
+  }
+
+  return is_valid();
 }
 
-void Image::set_pixel(int x, int y, const unsigned char* pixel)
+AsyncImage Image::load_async(const std::filesystem::path& path, bool flip_vertically, int priority, int channels,
+                             Type type)
 {
-  if (is_valid() && (0 <= x && x < m_width) && (0 <= y && y < m_height)) {
-    int i = (y * m_width + x) * m_channels;
-    for (int c = 0; c < m_channels; c++) {
-      m_data[i + c] = pixel[c];
+  auto promise = std::make_shared<std::promise<Image>>();
+
+  AsyncImage handle;
+  handle.m_future = promise->get_future();
+  handle.m_cancelled = std::make_shared<std::atomic<bool>>(false);
+
+  ThreadPool::global().submit(
+      [promise, cancelled = handle.m_cancelled, path, flip_vertically, channels, type]() {
+        Image image;
+        if (!cancelled->load()) {
+          image.load_mapped(path, flip_vertically, channels, type);
+        }
+        promise->set_value(std::move(image));
+      },
+      priority);
+
+  return handle;
+}
+
+void Image::flip_vertically()
+{
+  if (!is_valid()) {
+    return;
+  }
+
+  const std::size_t stride = static_cast<std::size_t>(m_width) * bytes_per_pixel();
+
+  for (int y = 0; y < m_height / 2; y++) {
+    unsigned char* a = m_data + y * stride;
+    unsigned char* b = m_data + (m_height - 1 - y) * stride;
+
+    std::size_t i = 0;
+#if defined(GFX_AVX2)
+    for (; i + 32 <= stride; i += 32) {
+      __m256i ra = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+      __m256i rb = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i));
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(a + i), rb);
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(b + i), ra);
+    }
+#endif
+#if defined(GFX_SSE2)
+    for (; i + 16 <= stride; i += 16) {
+      __m128i ra = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+      __m128i rb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i));
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(a + i), rb);
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(b + i), ra);
+    }
+#endif
+    for (; i < stride; i++) {
+      std::swap(a[i], b[i]);
     }
   }
 }
 
-glm::u8vec4 Image::pixel(int x, int y) const
+Image Image::convert(int channels, Type type) const
 {
-  glm::u8vec4 pixel(0);
+  if (!is_valid() || channels < 1 || channels > 4) {
+    return Image();
+  }
+
+  Image result(m_width, m_height, channels, type);
+  if (!result.is_valid()) {
+    return result;
+  }
+
+  const std::size_t src_stride = static_cast<std::size_t>(m_width) * bytes_per_pixel();
+  const std::size_t dst_stride = static_cast<std::size_t>(m_width) * result.bytes_per_pixel();
+
+  for_each_row(m_height, src_stride, [&](int y) {
+    const unsigned char* src = m_data + y * src_stride;
+    unsigned char* dst = result.m_data + y * dst_stride;
 
-  if (is_valid() && (0 <= x && x < m_width) && (0 <= y && y < m_height)) {
-    int i = (y * m_width + x) * m_channels;
-    for (int c = 0; c < glm::min(m_channels, 4); c++) {
-      pixel[c] = m_data[i + c];
+    if (type == m_type) {
+      convert_row(src, m_channels, dst, channels, type, m_width);
+      return;
     }
+
+    // channels are converted in the source type, values through one float row
+    std::vector<unsigned char> reordered(static_cast<std::size_t>(m_width) * channels * type_size(m_type));
+    std::vector<float> values(static_cast<std::size_t>(m_width) * channels);
+    convert_row(src, m_channels, reordered.data(), channels, m_type, m_width);
+    load_row(reordered.data(), m_type, values.data(), values.size());
+    store_row(values.data(), type, dst, values.size());
+  });
+
+  return result;
+}
+
+Image Image::to_linear() const
+{
+  if (!is_valid() || m_type != UNSIGNED_BYTE) {
+    return Image();
+  }
+
+  Image result(m_width, m_height, m_channels, FLOAT);
+  if (!result.is_valid()) {
+    return result;
   }
 
-  return pixel;
+  const std::size_t values = static_cast<std::size_t>(m_width) * m_channels;
+  for_each_row(m_height, values, [&](int y) {
+    srgb_to_linear(m_data + y * values, reinterpret_cast<float*>(result.m_data) + y * values, m_channels, m_width);
+  });
+
+  return result;
 }
 
-glm::u8vec4 Image::sample(const glm::vec2& uv, Sampling algorithm) const
+Image Image::to_srgb() const
 {
-  if (!is_valid() || !(0.f <= uv.x && uv.x <= 1.0f) || !(0.f <= uv.y && uv.y <= 1.0f)) {
-    return glm::u8vec4(0);
+  if (!is_valid() || (m_type != FLOAT && m_type != HALF_FLOAT)) {
+    return Image();
   }
 
-  switch (algorithm) {
-    // nearest neighbour
-    case gfx::Image::NEAREST: {
-      int x = static_cast<int>(uv.x * (m_width - 1));
-      int y = static_cast<int>(uv.y * (m_height - 1));
-      return pixel(x, y);
+  Image result(m_width, m_height, m_channels, UNSIGNED_BYTE);
+  if (!result.is_valid()) {
+    return result;
+  }
+
+  const std::size_t values = static_cast<std::size_t>(m_width) * m_channels;
+  for_each_row(m_height, values * sizeof(float), [&](int y) {
+    if (m_type == HALF_FLOAT) {
+      std::vector<float> row(values);
+      half_to_float(reinterpret_cast<const uint16_t*>(m_data) + y * values, row.data(), values);
+      linear_to_srgb(row.data(), result.m_data + y * values, m_channels, m_width);
+      return;
     }
-    // bilinear interpolation
-    case gfx::Image::LINEAR: {
-      float x = uv.x * (m_width - 1);
-      float y = uv.y * (m_height - 1);
+    linear_to_srgb(reinterpret_cast<const float*>(m_data) + y * values, result.m_data + y * values, m_channels,
+                   m_width);
+  });
 
-      int x0 = (int)x;
-      int y0 = (int)y;
-      float x_frac = x - x0;
-      float y_frac = y - x0;
+  return result;
+}
 
-      glm::u8vec4 tl = pixel(x0 + 0, y0 + 0);
-      glm::u8vec4 tr = pixel(x0 + 1, y0 + 0);
-      glm::u8vec4 bl = pixel(x0 + 0, y0 + 1);
-      glm::u8vec4 br = pixel(x0 + 1, y0 + 1);
+void Image::swizzle_rb()
+{
+  if (!is_valid() || m_channels < 3) {
+    return;
+  }
+
+  const std::size_t stride = static_cast<std::size_t>(m_width) * bytes_per_pixel();
 
-      glm::u8vec4 t = glm::mix(tl, tr, x_frac);
-      glm::u8vec4 b = glm::mix(bl, br, x_frac);
+  if (m_type == UNSIGNED_BYTE) {
+    for_each_row(m_height, stride, [&](int y) { gfx::swizzle_rb(m_data + y * stride, m_channels, m_width); });
+    return;
+  }
 
-      return glm::mix(t, b, y_frac);
+  const int size = type_size(m_type);
+  for_each_row(m_height, stride, [&](int y) {
+    unsigned char* row = m_data + y * stride;
+    for (int x = 0; x < m_width; x++) {
+      unsigned char* p = row + x * bytes_per_pixel();
+      std::swap_ranges(p, p + size, p + 2 * size);
     }
+  });
+}
+
+void Image::premultiply_alpha()
+{
+  if (!is_valid() || (m_channels != 2 && m_channels != 4)) {
+    return;
+  }
+
+  const std::size_t stride = static_cast<std::size_t>(m_width) * bytes_per_pixel();
+
+  for_each_row(m_height, stride, [&](int y) {
+    unsigned char* row = m_data + y * stride;
+    switch (m_type) {
+      case UNSIGNED_BYTE:
+        gfx::premultiply_alpha(row, m_channels, m_width);
+        break;
+      case FLOAT:
+        gfx::premultiply_alpha(reinterpret_cast<float*>(row), m_channels, m_width);
+        break;
+      default: {
+        // 16 bit goes through float, the round trip is exact
+        std::vector<float> values(static_cast<std::size_t>(m_width) * m_channels);
+        load_row(row, m_type, values.data(), values.size());
+        gfx::premultiply_alpha(values.data(), m_channels, m_width);
+        store_row(values.data(), m_type, row, values.size());
+        break;
+      }
+    }
+  });
+}
+
+bool Image::write_png(const std::filesystem::path& path) const { return ImageView(*this).write_png(path); }
+
+bool Image::write_hdr(const std::filesystem::path& path) const { return ImageView(*this).write_hdr(path); }
+
+void Image::set_pixel(int x, int y, const unsigned char* pixel) { ImageView(*this).set_pixel(x, y, pixel); }
+
+glm::u8vec4 Image::pixel(int x, int y) const { return ImageView(*this).pixel(x, y); }
+
+glm::u8vec4 Image::sample(const glm::vec2& uv, Sampling algorithm) const
+{
+  return ImageView(*this).sample(uv, algorithm);
+}
+
+void Image::sample_batch(const glm::vec2* uvs, glm::u8vec4* out, std::size_t count, Sampling algorithm,
+                         Wrap wrap) const
+{
+  if (!is_valid() || m_type != UNSIGNED_BYTE) {
+    std::fill(out, out + count, glm::u8vec4(0));
+    return;
+  }
+
+  BatchSampler sampler;
+  sampler.data = m_data;
+  sampler.width = m_width;
+  sampler.height = m_height;
+  sampler.channels = m_channels;
+  sampler.fwidth = static_cast<float>(m_width);
+  sampler.fheight = static_cast<float>(m_height);
+  sampler.max_x = static_cast<float>(m_width - 1);
+  sampler.max_y = static_cast<float>(m_height - 1);
+  sampler.scale_x = static_cast<float>(m_width) * 256.0f;
+  sampler.scale_y = static_cast<float>(m_height) * 256.0f;
+  sampler.wrap = wrap;
+
+  // the gather offsets are 32 bit
+  const bool gather = static_cast<std::size_t>(m_width) * m_height * m_channels <= INT32_MAX;
+
+  std::size_t i = 0;
+  uint32_t texel;
+
+  switch (algorithm) {
+    case gfx::Image::NEAREST:
+#if defined(GFX_AVX2)
+      if (gather) i = sample_nearest_avx2(sampler, uvs, out, count);
+#endif
+#if defined(GFX_SSE2)
+      i += sample_nearest_sse2(sampler, uvs + i, out + i, count - i);
+#endif
+      for (; i < count; i++) {
+        texel = sampler.nearest(uvs[i]);
+        std::memcpy(static_cast<void*>(&out[i]), &texel, sizeof(texel));
+      }
+      break;
+    case gfx::Image::LINEAR:
+#if defined(GFX_AVX2)
+      if (gather) i = sample_linear_avx2(sampler, uvs, out, count);
+#endif
+#if defined(GFX_SSE2)
+      i += sample_linear_sse2(sampler, uvs + i, out + i, count - i);
+#endif
+      for (; i < count; i++) {
+        texel = sampler.linear(uvs[i]);
+        std::memcpy(static_cast<void*>(&out[i]), &texel, sizeof(texel));
+      }
+      break;
     default:
       assert(false);
-      return glm::u8vec4();
+      break;
   }
+
+  (void)gather;
 }
 
+AsyncImage::AsyncImage() noexcept {}
+
+bool AsyncImage::is_valid() const { return m_future.valid(); }
+
+bool AsyncImage::ready() const
+{
+  return m_future.valid() && m_future.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+}
+
+void AsyncImage::wait() const
+{
+  if (m_future.valid()) {
+    m_future.wait();
+  }
+}
+
+Image AsyncImage::get() { return m_future.valid() ? m_future.get() : Image(); }
+
+void AsyncImage::cancel()
+{
+  if (m_cancelled) {
+    m_cancelled->store(true);
+  }
+}
+
+bool AsyncImage::cancelled() const { return m_cancelled && m_cancelled->load(); }
+
 }  // namespace gfx
\ No newline at end of file
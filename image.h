@@ -4,22 +4,41 @@
 #define _CRT_SECURE_NO_WARNINGS
 #include <GL/glew.h>
 
+#include <atomic>
+#include <cstddef>
 #include <filesystem>
+#include <future>
 #include <glm/glm.hpp>
+#include <memory>
 #include <string>
 
 namespace gfx
 {
+class AsyncImage;
+
 class Image
 {
  public:
   enum Format : GLint { RED = GL_RED, RG = GL_RG, RGB = GL_RGB, RGBA = GL_RGBA };
 
+  // half floats are ieee binary16, half the memory of FLOAT for hdr data that does not need its range
+  enum Type : GLenum {
+    UNSIGNED_BYTE = GL_UNSIGNED_BYTE,
+    UNSIGNED_SHORT = GL_UNSIGNED_SHORT,
+    HALF_FLOAT = GL_HALF_FLOAT,
+    FLOAT = GL_FLOAT
+  };
+
+  static constexpr int DEFAULT_CHANNELS = 3;
+  static constexpr int NATIVE_CHANNELS = 0;  // keep the channel count of the file
+
   enum Sampling { NEAREST, LINEAR };
 
+  enum Wrap { CLAMP, REPEAT };
+
   Image() noexcept;
-  Image(int width, int height, int channels) noexcept;
-  Image(const unsigned char* buffer, int len) noexcept;
+  Image(int width, int height, int channels, Type type = UNSIGNED_BYTE) noexcept;
+  Image(const unsigned char* buffer, int len, int channels = DEFAULT_CHANNELS, Type type = UNSIGNED_BYTE) noexcept;
 
   Image(const Image& ) = delete;
   Image& operator=(const Image& ) = delete;
@@ -33,25 +52,87 @@ class Image
   int width() const;
   int height() const;
   int channels() const;
+  Type type() const;
+  int bytes_per_channel() const;
+  int bytes_per_pixel() const;
+  std::size_t size_bytes() const;
 
   Format format() const;
-
-  bool load(const std::filesystem::path& path, bool flip_vertically = false);
+  // sized GL format for 16 bit, half float and float images, same as format() for 8 bit images
+  GLint internal_format() const;
+  static GLint internal_format(int channels, Type type);
+
+  // 16 bit images are loaded with stbi_load_16. float and half float images keep the range of .hdr files, other files
+  // are decoded at their own 8 or 16 bit depth and normalized to [0, 1] like Image::convert
+  bool load(const std::filesystem::path& path, bool flip_vertically = false, int channels = DEFAULT_CHANNELS,
+            Type type = UNSIGNED_BYTE);
+  // decode straight from a memory mapping, binary 8 bit ppm and pgm files are used in place without any copy
+  bool load_mapped(const std::filesystem::path& path, bool flip_vertically = false, int channels = DEFAULT_CHANNELS,
+                   Type type = UNSIGNED_BYTE);
+  // decode on the shared thread pool, higher priorities are decoded first
+  static AsyncImage load_async(const std::filesystem::path& path, bool flip_vertically = false, int priority = 0,
+                               int channels = DEFAULT_CHANNELS, Type type = UNSIGNED_BYTE);
+  // png output is 8 bit only
   bool write_png(const std::filesystem::path& path) const;
+  // radiance .hdr output of float and half float images
+  bool write_hdr(const std::filesystem::path& path) const;
 
   glm::u8vec4 pixel(int x, int y) const;
   glm::u8vec4 sample(const glm::vec2&, Sampling algorithm = NEAREST) const;
 
+  // sample count uvs of an 8 bit image at once, texel centers follow the OpenGL convention (u * width - 0.5)
+  void sample_batch(const glm::vec2* uvs, glm::u8vec4* out, std::size_t count, Sampling algorithm = NEAREST,
+                    Wrap wrap = CLAMP) const;
+
+  // pixel holds bytes_per_pixel() bytes
   void set_pixel(int x, int y, const unsigned char* pixel);
 
+  // swap rows in place
+  void flip_vertically();
+
+  // copy with another channel count and type, 8 and 16 bit values map to [0, 1] in float and half float images
+  Image convert(int channels, Type type) const;
+  // 8 bit srgb to linear float and back from float or half float, alpha stays linear
+  Image to_linear() const;
+  Image to_srgb() const;
+
+  // in place, rgb(a) <-> bgr(a)
+  void swizzle_rb();
+  void premultiply_alpha();
+
   bool is_valid() const;
 
  private:
   unsigned char* m_data = nullptr;
   int m_width, m_height, m_channels;
+  Type m_type;
+  std::shared_ptr<void> m_owner;  // set when m_data points into memory the image does not own
 
   void cleanup();
   void reset();
   void swap(Image&);
 };
+
+// handle to an image that is decoded in the background
+class AsyncImage
+{
+ public:
+  AsyncImage() noexcept;
+
+  bool is_valid() const;  // false once get() was called
+  bool ready() const;
+  void wait() const;
+
+  // blocks until the decode is done, the image is invalid if the load failed or was cancelled
+  Image get();
+
+  // a load that has not started yet is skipped, one that is running finishes normally
+  void cancel();
+  bool cancelled() const;
+
+ private:
+  friend class Image;
+  std::future<Image> m_future;
+  std::shared_ptr<std::atomic<bool>> m_cancelled;
+};
 }  // namespace gfx
@@ -0,0 +1,200 @@
+#include "image_allocator.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+namespace gfx
+{
+
+namespace
+{
+
+thread_local ImageAllocator* current_allocator = nullptr;
+
+// in front of every block, keeps the pixels 16 byte aligned for the SIMD kernels
+struct alignas(16) BlockHeader {
+  ImageAllocator* allocator;
+  std::size_t size;  // including the header
+};
+
+static_assert(sizeof(BlockHeader) == 16, "the block header has to keep 16 byte alignment");
+
+constexpr std::size_t MIN_CLASS_SIZE = 256;
+constexpr std::size_t ALIGNMENT = 16;
+
+// round up to a quarter power of two, wastes at most 25%
+std::size_t class_size(std::size_t size)
+{
+  if (size <= MIN_CLASS_SIZE) {
+    return MIN_CLASS_SIZE;
+  }
+  std::size_t power = MIN_CLASS_SIZE;
+  while (power * 2 < size) {
+    power *= 2;
+  }
+  std::size_t step = power / 4;
+  return (size + step - 1) / step * step;
+}
+
+}  // namespace
+
+PoolAllocator::PoolAllocator(std::size_t max_cached_bytes) : m_max_cached_bytes(max_cached_bytes) {}
+
+PoolAllocator::~PoolAllocator() { trim(); }
+
+void* PoolAllocator::allocate(std::size_t size)
+{
+  size = class_size(size);
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_free.find(size);
+    if (it != m_free.end() && !it->second.empty()) {
+      void* ptr = it->second.back();
+      it->second.pop_back();
+      m_cached_bytes -= size;
+      return ptr;
+    }
+  }
+  return std::malloc(size);
+}
+
+void PoolAllocator::deallocate(void* ptr, std::size_t size)
+{
+  size = class_size(size);
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_cached_bytes + size <= m_max_cached_bytes) {
+      m_free[size].push_back(ptr);
+      m_cached_bytes += size;
+      return;
+    }
+  }
+  std::free(ptr);
+}
+
+void PoolAllocator::trim()
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  for (auto& [size, blocks] : m_free) {
+    for (void* ptr : blocks) {
+      std::free(ptr);
+    }
+  }
+  m_free.clear();
+  m_cached_bytes = 0;
+}
+
+std::size_t PoolAllocator::cached_bytes() const
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_cached_bytes;
+}
+
+FrameArena::FrameArena(std::size_t capacity)
+    : m_memory(static_cast<unsigned char*>(std::malloc(capacity))), m_capacity(m_memory ? capacity : 0)
+{
+}
+
+FrameArena::~FrameArena() { std::free(m_memory); }
+
+void* FrameArena::allocate(std::size_t size)
+{
+  size = (size + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+
+  std::size_t offset = m_offset.fetch_add(size);
+  if (offset + size <= m_capacity) {
+    return m_memory + offset;
+  }
+
+  return std::malloc(size);
+}
+
+void FrameArena::deallocate(void* ptr, std::size_t)
+{
+  // arena memory is only reclaimed by reset()
+  auto* p = static_cast<unsigned char*>(ptr);
+  if (p < m_memory || m_memory + m_capacity <= p) {
+    std::free(ptr);
+  }
+}
+
+void FrameArena::reset() { m_offset.store(0); }
+
+std::size_t FrameArena::used() const { return std::min(m_offset.load(), m_capacity); }
+
+std::size_t FrameArena::capacity() const { return m_capacity; }
+
+ImageAllocatorScope::ImageAllocatorScope(ImageAllocator& allocator) : m_previous(current_allocator)
+{
+  current_allocator = &allocator;
+}
+
+ImageAllocatorScope::~ImageAllocatorScope() { current_allocator = m_previous; }
+
+namespace detail
+{
+
+void* image_malloc(std::size_t size)
+{
+  ImageAllocator* allocator = current_allocator;
+  std::size_t total = size + sizeof(BlockHeader);
+
+  void* block = allocator ? allocator->allocate(total) : std::malloc(total);
+  if (!block) {
+    return nullptr;
+  }
+
+  auto* header = static_cast<BlockHeader*>(block);
+  header->allocator = allocator;
+  header->size = total;
+  return header + 1;
+}
+
+void* image_realloc(void* ptr, std::size_t, std::size_t new_size)
+{
+  if (!ptr) {
+    return image_malloc(new_size);
+  }
+
+  // stays with the allocator of the original block
+  BlockHeader* header = static_cast<BlockHeader*>(ptr) - 1;
+  ImageAllocator* allocator = header->allocator;
+
+  if (!allocator) {
+    auto* block = static_cast<BlockHeader*>(std::realloc(header, new_size + sizeof(BlockHeader)));
+    if (!block) {
+      return nullptr;
+    }
+    block->size = new_size + sizeof(BlockHeader);
+    return block + 1;
+  }
+
+  auto* block = static_cast<BlockHeader*>(allocator->allocate(new_size + sizeof(BlockHeader)));
+  if (!block) {
+    return nullptr;
+  }
+  block->allocator = allocator;
+  block->size = new_size + sizeof(BlockHeader);
+  std::memcpy(block + 1, ptr, std::min(header->size - sizeof(BlockHeader), new_size));
+  allocator->deallocate(header, header->size);
+  return block + 1;
+}
+
+void image_free(void* ptr)
+{
+  if (!ptr) {
+    return;
+  }
+
+  BlockHeader* header = static_cast<BlockHeader*>(ptr) - 1;
+  if (header->allocator) {
+    header->allocator->deallocate(header, header->size);
+  } else {
+    std::free(header);
+  }
+}
+
+}  // namespace detail
+
+}  // namespace gfx
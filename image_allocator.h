@@ -0,0 +1,90 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <map>
+#include <mutex>
+#include <vector>
+
+namespace gfx
+{
+// storage for image pixels and the decoder's scratch buffers
+class ImageAllocator
+{
+ public:
+  virtual ~ImageAllocator() = default;
+  virtual void* allocate(std::size_t size) = 0;
+  virtual void deallocate(void* ptr, std::size_t size) = 0;
+};
+
+// recycles blocks in size classes of a quarter power of two, thread safe
+class PoolAllocator : public ImageAllocator
+{
+ public:
+  explicit PoolAllocator(std::size_t max_cached_bytes = 256u << 20);
+  ~PoolAllocator() override;
+
+  void* allocate(std::size_t size) override;
+  void deallocate(void* ptr, std::size_t size) override;
+
+  // release all cached blocks
+  void trim();
+
+  std::size_t cached_bytes() const;
+
+ private:
+  mutable std::mutex m_mutex;
+  std::map<std::size_t, std::vector<void*>> m_free;
+  std::size_t m_cached_bytes = 0;
+  std::size_t m_max_cached_bytes;
+};
+
+// bump allocator for images that live for one frame, memory is reclaimed all at once by reset()
+class FrameArena : public ImageAllocator
+{
+ public:
+  explicit FrameArena(std::size_t capacity);
+  ~FrameArena() override;
+
+  FrameArena(const FrameArena&) = delete;
+  FrameArena& operator=(const FrameArena&) = delete;
+
+  // when the arena is full allocations fall back to the heap
+  void* allocate(std::size_t size) override;
+  void deallocate(void* ptr, std::size_t size) override;
+
+  // every image allocated from the arena must be gone before this is called
+  void reset();
+
+  std::size_t used() const;
+  std::size_t capacity() const;
+
+ private:
+  unsigned char* m_memory;
+  std::size_t m_capacity;
+  std::atomic<std::size_t> m_offset{0};
+};
+
+// images created on this thread while the scope is alive take their memory from allocator
+class ImageAllocatorScope
+{
+ public:
+  explicit ImageAllocatorScope(ImageAllocator& allocator);
+  ~ImageAllocatorScope();
+
+  ImageAllocatorScope(const ImageAllocatorScope&) = delete;
+  ImageAllocatorScope& operator=(const ImageAllocatorScope&) = delete;
+
+ private:
+  ImageAllocator* m_previous;
+};
+
+namespace detail
+{
+// hooks for stb_image, every block remembers the allocator it came from
+void* image_malloc(std::size_t size);
+void* image_realloc(void* ptr, std::size_t old_size, std::size_t new_size);
+void image_free(void* ptr);
+}  // namespace detail
+
+}  // namespace gfx
@@ -0,0 +1,219 @@
+#include "image_cache.h"
+
+#include <cstring>
+#include <system_error>
+
+#include "mapped_file.h"
+
+namespace gfx
+{
+
+namespace
+{
+
+inline uint64_t mix(uint64_t h, uint64_t v)
+{
+  h ^= v * 0x9e3779b97f4a7c15ull;
+  h = (h << 31) | (h >> 33);
+  return h * 0xc2b2ae3d27d4eb4full;
+}
+
+std::string options_key(bool flip_vertically, int channels, Image::Type type)
+{
+  return "|" + std::to_string(flip_vertically) + "|" + std::to_string(channels) + "|" + std::to_string(type);
+}
+
+}  // namespace
+
+ImageCache::ImageCache(std::size_t budget_bytes, bool hash_contents)
+    : m_budget(budget_bytes), m_size(0), m_hits(0), m_misses(0), m_hash_contents(hash_contents)
+{
+}
+
+std::shared_ptr<const Image> ImageCache::load(const std::filesystem::path& path, bool flip_vertically, int channels,
+                                              Image::Type type)
+{
+  std::string key;
+  MappedFile file;
+
+  if (m_hash_contents) {
+    // the mapping is decoded from on a miss, so the file is read once either way
+    file = MappedFile(path);
+    if (!file.is_valid()) {
+      return nullptr;
+    }
+    key = std::to_string(hash(file.data(), file.size()));
+  } else {
+    std::error_code error;
+    auto time = std::filesystem::last_write_time(path, error);
+    if (error) {
+      return nullptr;
+    }
+    auto size = std::filesystem::file_size(path, error);
+    if (error) {
+      return nullptr;
+    }
+    key = std::filesystem::absolute(path, error).lexically_normal().string() + "|" +
+          std::to_string(time.time_since_epoch().count()) + "|" + std::to_string(size);
+  }
+  key += options_key(flip_vertically, channels, type);
+
+  std::unique_lock<std::mutex> lock(m_mutex);
+
+  auto it = m_entries.find(key);
+  if (it != m_entries.end()) {
+    m_lru.splice(m_lru.begin(), m_lru, it->second.lru);
+    m_hits++;
+    if (it->second.ready) {
+      return it->second.image;
+    }
+    Future pending = it->second.pending;
+    lock.unlock();
+    // waits when another thread is still decoding this key
+    return pending.get();
+  }
+
+  std::promise<std::shared_ptr<const Image>> promise;
+  m_lru.push_front(key);
+  m_entries.emplace(key, Entry{promise.get_future().share(), nullptr, 0, false, m_lru.begin()});
+  m_misses++;
+  lock.unlock();
+
+  auto image = std::make_shared<Image>();
+  if (file.is_valid() && file.size() <= INT32_MAX) {
+    *image = Image(file.data(), static_cast<int>(file.size()), channels, type);
+    if (flip_vertically) {
+      image->flip_vertically();
+    }
+  } else if (!m_hash_contents) {
+    image->load(path, flip_vertically, channels, type);
+  }
+
+  std::shared_ptr<const Image> result;
+  if (image->is_valid()) {
+    result = std::move(image);
+  }
+
+  // waiters are released first, nothing below blocks on the future
+  promise.set_value(result);
+
+  lock.lock();
+  it = m_entries.find(key);
+  if (result) {
+    // result is still held here, so the new entry itself is never evicted
+    it->second.pending = Future();
+    it->second.image = result;
+    it->second.size = result->size_bytes();
+    it->second.ready = true;
+    m_size += it->second.size;
+    evict();
+  } else {
+    m_lru.erase(it->second.lru);
+    m_entries.erase(it);
+  }
+
+  return result;
+}
+
+void ImageCache::evict()
+{
+  // the cache holds one reference itself, anything above that is a user
+  auto it = m_lru.end();
+  while (m_size > m_budget && it != m_lru.begin()) {
+    --it;
+    auto entry = m_entries.find(*it);
+    if (!entry->second.ready || entry->second.image.use_count() > 1) {
+      continue;
+    }
+    m_size -= entry->second.size;
+    m_entries.erase(entry);
+    it = m_lru.erase(it);
+  }
+}
+
+void ImageCache::set_budget(std::size_t budget_bytes)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_budget = budget_bytes;
+  evict();
+}
+
+std::size_t ImageCache::budget() const
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_budget;
+}
+
+std::size_t ImageCache::size_bytes() const
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_size;
+}
+
+std::size_t ImageCache::entries() const
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_entries.size();
+}
+
+std::size_t ImageCache::hits() const
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_hits;
+}
+
+std::size_t ImageCache::misses() const
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_misses;
+}
+
+void ImageCache::clear()
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+
+  // entries that are still decoding finish normally
+  for (auto it = m_entries.begin(); it != m_entries.end();) {
+    if (it->second.ready) {
+      m_size -= it->second.size;
+      m_lru.erase(it->second.lru);
+      it = m_entries.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+ImageCache& ImageCache::global()
+{
+  static ImageCache cache;
+  return cache;
+}
+
+uint64_t ImageCache::hash(const unsigned char* data, std::size_t size)
+{
+  // four independent lanes keep the multiplies in flight
+  uint64_t lanes[4] = {0x243f6a8885a308d3ull, 0x13198a2e03707344ull, 0xa4093822299f31d0ull, 0x082efa98ec4e6c89ull};
+
+  std::size_t i = 0;
+  for (; i + 32 <= size; i += 32) {
+    for (int l = 0; l < 4; l++) {
+      uint64_t v;
+      std::memcpy(&v, data + i + l * 8, sizeof(v));
+      lanes[l] = mix(lanes[l], v);
+    }
+  }
+
+  uint64_t h = mix(mix(lanes[0], lanes[1]), mix(lanes[2], lanes[3]));
+  for (; i < size; i++) {
+    h = mix(h, data[i]);
+  }
+  h = mix(h, size);
+
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdull;
+  h ^= h >> 33;
+  return h;
+}
+
+}  // namespace gfx
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <future>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "image.h"
+
+namespace gfx
+{
+// decoded images shared between everyone who loads the same file with the same options
+//
+// entries are keyed by path, modification time, file size and load options. with content hashing, identical files
+// under different paths share one image as well. concurrent loads of the same key decode once. images nobody else
+// holds are evicted least recently used first once the budget is exceeded, images still in use stay
+class ImageCache
+{
+ public:
+  explicit ImageCache(std::size_t budget_bytes = std::size_t(512) << 20, bool hash_contents = false);
+
+  ImageCache(const ImageCache&) = delete;
+  ImageCache& operator=(const ImageCache&) = delete;
+
+  // null if the file can not be read or decoded, failures are not cached
+  std::shared_ptr<const Image> load(const std::filesystem::path& path, bool flip_vertically = false,
+                                    int channels = Image::DEFAULT_CHANNELS, Image::Type type = Image::UNSIGNED_BYTE);
+
+  void set_budget(std::size_t budget_bytes);
+  std::size_t budget() const;
+  std::size_t size_bytes() const;  // decoded bytes held by the cache
+  std::size_t entries() const;
+  std::size_t hits() const;
+  std::size_t misses() const;
+
+  // drops every finished entry, images still in use stay alive with their users
+  void clear();
+
+  // shared cache for the whole process
+  static ImageCache& global();
+
+  // 64 bit content hash, not cryptographic
+  static uint64_t hash(const unsigned char* data, std::size_t size);
+
+ private:
+  using Future = std::shared_future<std::shared_ptr<const Image>>;
+
+  // pending entries hand out the future, finished ones the image itself so that its use count says who holds it
+  struct Entry {
+    Future pending;
+    std::shared_ptr<const Image> image;
+    std::size_t size;
+    bool ready;
+    std::list<std::string>::iterator lru;
+  };
+
+  mutable std::mutex m_mutex;
+  std::unordered_map<std::string, Entry> m_entries;
+  std::list<std::string> m_lru;  // most recently used first
+  std::size_t m_budget, m_size;
+  std::size_t m_hits, m_misses;
+  bool m_hash_contents;
+
+  void evict();
+};
+}  // namespace gfx
@@ -0,0 +1,276 @@
+#include "image_compare.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <mutex>
+#include <vector>
+
+#include "image_rows.h"
+#include "simd.h"
+#include "thread_pool.h"
+
+namespace gfx
+{
+
+namespace
+{
+
+bool comparable(const ImageView& a, const ImageView& b)
+{
+  return a.is_valid() && b.is_valid() && a.width() == b.width() && a.height() == b.height() &&
+         a.channels() == b.channels() && a.type() == Image::UNSIGNED_BYTE && b.type() == Image::UNSIGNED_BYTE;
+}
+
+// max abs difference per byte position and the sum of squared differences of one row
+void diff_row(const unsigned char* a, const unsigned char* b, std::size_t count, int channels, int* max_abs,
+              uint64_t* sum_sq)
+{
+  std::size_t i = 0;
+  uint64_t sum = 0;
+
+#if defined(GFX_SSE2)
+  // 16 bytes hold whole pixels for 1, 2 and 4 channels, 3 channels line up again after 48
+  const std::size_t step = channels == 3 ? 48 : 16;
+  const int registers = channels == 3 ? 3 : 1;
+  const __m128i zero = _mm_setzero_si128();
+
+  __m128i max[3] = {zero, zero, zero};
+  __m128i acc = zero;
+  int pending = 0;
+
+  for (; i + step <= count; i += step) {
+    for (int r = 0; r < registers; r++) {
+      __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i + r * 16));
+      __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i + r * 16));
+      __m128i d = _mm_or_si128(_mm_subs_epu8(va, vb), _mm_subs_epu8(vb, va));
+      max[r] = _mm_max_epu8(max[r], d);
+
+      __m128i lo = _mm_unpacklo_epi8(d, zero);
+      __m128i hi = _mm_unpackhi_epi8(d, zero);
+      acc = _mm_add_epi32(acc, _mm_add_epi32(_mm_madd_epi16(lo, lo), _mm_madd_epi16(hi, hi)));
+    }
+
+    // each lane gains at most 4 * 255^2 per register, flush long before it can overflow
+    if (++pending == 1024) {
+      alignas(16) uint32_t lanes[4];
+      _mm_store_si128(reinterpret_cast<__m128i*>(lanes), acc);
+      sum += static_cast<uint64_t>(lanes[0]) + lanes[1] + lanes[2] + lanes[3];
+      acc = zero;
+      pending = 0;
+    }
+  }
+
+  alignas(16) uint32_t lanes[4];
+  _mm_store_si128(reinterpret_cast<__m128i*>(lanes), acc);
+  sum += static_cast<uint64_t>(lanes[0]) + lanes[1] + lanes[2] + lanes[3];
+
+  for (int r = 0; r < registers; r++) {
+    alignas(16) unsigned char bytes[16];
+    _mm_store_si128(reinterpret_cast<__m128i*>(bytes), max[r]);
+    for (int j = 0; j < 16; j++) {
+      int c = (r * 16 + j) % channels;
+      max_abs[c] = std::max(max_abs[c], static_cast<int>(bytes[j]));
+    }
+  }
+#endif
+
+  for (; i < count; i++) {
+    int d = std::abs(a[i] - b[i]);
+    int c = static_cast<int>(i % channels);
+    max_abs[c] = std::max(max_abs[c], d);
+    sum += static_cast<uint64_t>(d * d);
+  }
+
+  *sum_sq += sum;
+}
+
+struct WindowSums {
+  uint64_t a[4], b[4], aa[4], bb[4], ab[4];
+};
+
+// sums of one size x size window for every channel
+void window_sums(const ImageView& a, const ImageView& b, int x0, int y0, int size, WindowSums& s)
+{
+  const int channels = a.channels();
+  s = WindowSums();
+
+  for (int y = y0; y < y0 + size; y++) {
+    const unsigned char* ra = a.row(y) + x0 * channels;
+    const unsigned char* rb = b.row(y) + x0 * channels;
+
+    int x = 0;
+#if defined(GFX_SSE2)
+    // one pixel per register, the lanes are the channels
+    if (channels == 4) {
+      const __m128i zero = _mm_setzero_si128();
+      __m128i sa = zero, sb = zero, saa = zero, sbb = zero, sab = zero;
+      for (; x < size; x++) {
+        int pa, pb;
+        std::memcpy(&pa, ra + x * 4, 4);
+        std::memcpy(&pb, rb + x * 4, 4);
+        // 32 bit lanes whose upper 16 bits are zero, so madd is a plain 32 bit multiply
+        __m128i va = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(pa), zero), zero);
+        __m128i vb = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(pb), zero), zero);
+        sa = _mm_add_epi32(sa, va);
+        sb = _mm_add_epi32(sb, vb);
+        saa = _mm_add_epi32(saa, _mm_madd_epi16(va, va));
+        sbb = _mm_add_epi32(sbb, _mm_madd_epi16(vb, vb));
+        sab = _mm_add_epi32(sab, _mm_madd_epi16(va, vb));
+      }
+
+      alignas(16) uint32_t lanes[5][4];
+      _mm_store_si128(reinterpret_cast<__m128i*>(lanes[0]), sa);
+      _mm_store_si128(reinterpret_cast<__m128i*>(lanes[1]), sb);
+      _mm_store_si128(reinterpret_cast<__m128i*>(lanes[2]), saa);
+      _mm_store_si128(reinterpret_cast<__m128i*>(lanes[3]), sbb);
+      _mm_store_si128(reinterpret_cast<__m128i*>(lanes[4]), sab);
+      for (int c = 0; c < 4; c++) {
+        s.a[c] += lanes[0][c];
+        s.b[c] += lanes[1][c];
+        s.aa[c] += lanes[2][c];
+        s.bb[c] += lanes[3][c];
+        s.ab[c] += lanes[4][c];
+      }
+    }
+#endif
+    for (; x < size; x++) {
+      for (int c = 0; c < channels; c++) {
+        uint64_t va = ra[x * channels + c], vb = rb[x * channels + c];
+        s.a[c] += va;
+        s.b[c] += vb;
+        s.aa[c] += va * va;
+        s.bb[c] += vb * vb;
+        s.ab[c] += va * vb;
+      }
+    }
+  }
+}
+
+double window_ssim(const WindowSums& s, int c, double n)
+{
+  const double c1 = (0.01 * 255) * (0.01 * 255);
+  const double c2 = (0.03 * 255) * (0.03 * 255);
+
+  double mean_a = s.a[c] / n, mean_b = s.b[c] / n;
+  double var_a = s.aa[c] / n - mean_a * mean_a;
+  double var_b = s.bb[c] / n - mean_b * mean_b;
+  double cov = s.ab[c] / n - mean_a * mean_b;
+
+  return ((2 * mean_a * mean_b + c1) * (2 * cov + c2)) /
+         ((mean_a * mean_a + mean_b * mean_b + c1) * (var_a + var_b + c2));
+}
+
+double ssim(const ImageView& a, const ImageView& b, int window)
+{
+  const int size = std::min({window, a.width(), a.height()});
+  const int step = std::max(1, size / 2);
+  const int windows_x = (a.width() - size) / step + 1;
+  const int windows_y = (a.height() - size) / step + 1;
+  const int channels = a.channels();
+
+  std::mutex mutex;
+  double total = 0.0;
+
+  ThreadPool::global().parallel_for(0, windows_y, [&](int begin, int end) {
+    double local = 0.0;
+    WindowSums sums;
+    for (int wy = begin; wy < end; wy++) {
+      for (int wx = 0; wx < windows_x; wx++) {
+        window_sums(a, b, wx * step, wy * step, size, sums);
+        for (int c = 0; c < channels; c++) {
+          local += window_ssim(sums, c, static_cast<double>(size) * size);
+        }
+      }
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    total += local;
+  });
+
+  return total / (static_cast<double>(windows_x) * windows_y * channels);
+}
+
+}  // namespace
+
+bool compare(const ImageView& a, const ImageView& b, ImageDifference& difference, int ssim_window)
+{
+  difference = ImageDifference();
+  if (!comparable(a, b)) {
+    return false;
+  }
+
+  const int channels = a.channels();
+  const std::size_t count = static_cast<std::size_t>(a.width()) * channels;
+
+  std::mutex mutex;
+  uint64_t sum_sq = 0;
+
+  ThreadPool::global().parallel_for(
+      0, a.height(),
+      [&](int begin, int end) {
+        int max_abs[4] = {};
+        uint64_t sum = 0;
+        for (int y = begin; y < end; y++) {
+          diff_row(a.row(y), b.row(y), count, channels, max_abs, &sum);
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        for (int c = 0; c < channels; c++) {
+          difference.max_abs[c] = std::max(difference.max_abs[c], max_abs[c]);
+        }
+        sum_sq += sum;
+      },
+      detail::row_grain(count));
+
+  difference.mse = static_cast<double>(sum_sq) / (static_cast<double>(count) * a.height());
+  difference.psnr = difference.mse > 0.0 ? 10.0 * std::log10(255.0 * 255.0 / difference.mse)
+                                         : std::numeric_limits<double>::infinity();
+
+  if (ssim_window > 0) {
+    difference.ssim = ssim(a, b, ssim_window);
+  }
+
+  return true;
+}
+
+Image difference_heatmap(const ImageView& a, const ImageView& b, float scale)
+{
+  if (!comparable(a, b)) {
+    return Image();
+  }
+
+  Image heatmap(a.width(), a.height(), 3);
+  if (!heatmap.is_valid()) {
+    return heatmap;
+  }
+
+  const int channels = a.channels();
+  const std::size_t stride = static_cast<std::size_t>(a.width()) * 3;
+
+  ThreadPool::global().parallel_for(0, a.height(), [&](int begin, int end) {
+    for (int y = begin; y < end; y++) {
+      const unsigned char* ra = a.row(y);
+      const unsigned char* rb = b.row(y);
+      unsigned char* out = heatmap.data() + y * stride;
+
+      for (int x = 0; x < a.width(); x++) {
+        int d = 0;
+        for (int c = 0; c < channels; c++) {
+          d = std::max(d, std::abs(ra[x * channels + c] - rb[x * channels + c]));
+        }
+
+        // three ramps of 255 steps: red, then green, then blue
+        int t = std::clamp(static_cast<int>(d * scale * 3.0f + 0.5f), 0, 3 * 255);
+        out[x * 3 + 0] = static_cast<unsigned char>(std::min(t, 255));
+        out[x * 3 + 1] = static_cast<unsigned char>(std::clamp(t - 255, 0, 255));
+        out[x * 3 + 2] = static_cast<unsigned char>(std::clamp(t - 2 * 255, 0, 255));
+      }
+    }
+  });
+
+  return heatmap;
+}
+
+}  // namespace gfx
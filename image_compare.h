@@ -0,0 +1,24 @@
+#pragma once
+
+#include "image.h"
+#include "image_view.h"
+
+namespace gfx
+{
+struct ImageDifference {
+  int max_abs[4];   // per channel, in 8 bit steps
+  double mse;       // over all channels, in 8 bit steps squared
+  double psnr;      // in dB, infinite for identical images
+  double ssim;      // mean structural similarity of all windows and channels, 1 for identical images
+};
+
+// 8 bit images of the same size and channel count, false otherwise
+//
+// rows are split across the shared thread pool, the sums run on SSE2. ssim uses square windows that overlap by half,
+// a window of 0 skips it and leaves ssim at 0
+bool compare(const ImageView& a, const ImageView& b, ImageDifference& difference, int ssim_window = 8);
+
+// rgb image of the largest channel difference of every pixel, black through red and yellow to white,
+// scale stretches small differences, an invalid image when the inputs can not be compared
+Image difference_heatmap(const ImageView& a, const ImageView& b, float scale = 1.0f);
+}  // namespace gfx
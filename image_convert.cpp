@@ -0,0 +1,467 @@
+#include "image_convert.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "simd.h"
+
+namespace gfx
+{
+
+namespace
+{
+
+constexpr int ENCODE_LUT_SIZE = 1 << 14;
+
+struct TransferTables {
+  float srgb_to_linear[256];
+  unsigned char linear_to_srgb[ENCODE_LUT_SIZE];
+
+  TransferTables()
+  {
+    for (int i = 0; i < 256; i++) {
+      float c = i / 255.0f;
+      srgb_to_linear[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+    }
+    for (int i = 0; i < ENCODE_LUT_SIZE; i++) {
+      float l = i / static_cast<float>(ENCODE_LUT_SIZE - 1);
+      float c = l <= 0.0031308f ? l * 12.92f : 1.055f * std::pow(l, 1.0f / 2.4f) - 0.055f;
+      linear_to_srgb[i] = static_cast<unsigned char>(std::clamp(c * 255.0f + 0.5f, 0.0f, 255.0f));
+    }
+  }
+};
+
+const TransferTables& transfer_tables()
+{
+  static const TransferTables tables;
+  return tables;
+}
+
+inline int alpha_channel(int channels) { return (channels == 2 || channels == 4) ? channels - 1 : -1; }
+
+// nan goes to 0 like it does with the max/min pair in the vector paths
+inline float saturate(float v) { return v > 0.0f ? (v < 1.0f ? v : 1.0f) : 0.0f; }
+
+template <typename T>
+struct Range;
+
+template <>
+struct Range<unsigned char> {
+  static constexpr unsigned char one = 255;
+  static unsigned char luma(unsigned char r, unsigned char g, unsigned char b)
+  {
+    return static_cast<unsigned char>((r * 77 + g * 150 + b * 29) >> 8);
+  }
+};
+
+template <>
+struct Range<uint16_t> {
+  static constexpr uint16_t one = 65535;
+  static uint16_t luma(uint16_t r, uint16_t g, uint16_t b)
+  {
+    return static_cast<uint16_t>((r * 77u + g * 150u + b * 29u) >> 8);
+  }
+};
+
+template <>
+struct Range<float> {
+  static constexpr float one = 1.0f;
+  static float luma(float r, float g, float b) { return (r * 77.0f + g * 150.0f + b * 29.0f) / 256.0f; }
+};
+
+template <typename T>
+void convert_channels_scalar(const T* src, int src_channels, T* dst, int dst_channels, std::size_t count)
+{
+  const T one = Range<T>::one;
+
+  for (std::size_t i = 0; i < count; i++, src += src_channels, dst += dst_channels) {
+    // grey, alpha and color of the source pixel
+    T r, g, b, a;
+    switch (src_channels) {
+      case 1:
+        r = g = b = src[0];
+        a = one;
+        break;
+      case 2:
+        r = g = b = src[0];
+        a = src[1];
+        break;
+      case 3:
+        r = src[0], g = src[1], b = src[2];
+        a = one;
+        break;
+      default:
+        r = src[0], g = src[1], b = src[2];
+        a = src[3];
+        break;
+    }
+
+    bool grey_source = src_channels < 3;
+    switch (dst_channels) {
+      case 1:
+        dst[0] = grey_source ? r : Range<T>::luma(r, g, b);
+        break;
+      case 2:
+        dst[0] = grey_source ? r : Range<T>::luma(r, g, b);
+        dst[1] = a;
+        break;
+      case 3:
+        dst[0] = r, dst[1] = g, dst[2] = b;
+        break;
+      default:
+        dst[0] = r, dst[1] = g, dst[2] = b, dst[3] = a;
+        break;
+    }
+  }
+}
+
+// rounded x / 255 for x up to 255 * 255, the vector path uses the same expression on 16 bit lanes
+inline unsigned div255(unsigned x)
+{
+  x += 128;
+  return (x + (x >> 8)) >> 8;
+}
+
+// round to nearest even, subnormals go through a float add that does the rounding
+uint16_t float_to_half_scalar(float value)
+{
+  uint32_t x;
+  std::memcpy(&x, &value, sizeof(x));
+
+  const uint32_t sign = (x >> 16) & 0x8000;
+  x &= 0x7fffffff;
+
+  if (x >= 0x47800000) {
+    // overflow to infinity, nans keep the top of their payload and become quiet
+    return static_cast<uint16_t>(sign | (x > 0x7f800000 ? 0x7e00 | ((x >> 13) & 0x3ff) : 0x7c00));
+  }
+
+  if (x < 0x38800000) {
+    const uint32_t magic_bits = 0x3f000000;  // 0.5, its ulp is the smallest half subnormal
+    float magic, f;
+    std::memcpy(&magic, &magic_bits, sizeof(magic));
+    std::memcpy(&f, &x, sizeof(f));
+    f += magic;
+    std::memcpy(&x, &f, sizeof(x));
+    return static_cast<uint16_t>(sign | (x - magic_bits));
+  }
+
+  const uint32_t odd = (x >> 13) & 1;
+  x += 0xc8000fff + odd;  // rebias the exponent from 127 to 15 and round
+  return static_cast<uint16_t>(sign | (x >> 13));
+}
+
+float half_to_float_scalar(uint16_t value)
+{
+  const uint32_t sign = static_cast<uint32_t>(value & 0x8000) << 16;
+  const uint32_t exponent = (value >> 10) & 0x1f;
+  const uint32_t mantissa = value & 0x3ff;
+
+  uint32_t x;
+  if (exponent == 0) {
+    float f = std::ldexp(static_cast<float>(mantissa), -24);
+    std::memcpy(&x, &f, sizeof(x));
+    x |= sign;
+  } else if (exponent == 31) {
+    x = sign | 0x7f800000 | (mantissa << 13) | (mantissa ? 0x400000 : 0);
+  } else {
+    x = sign | ((exponent + 112) << 23) | (mantissa << 13);
+  }
+
+  float f;
+  std::memcpy(&f, &x, sizeof(f));
+  return f;
+}
+
+}  // namespace
+
+void convert_channels(const unsigned char* src, int src_channels, unsigned char* dst, int dst_channels,
+                      std::size_t count)
+{
+  std::size_t i = 0;
+#if defined(GFX_AVX2)
+  // rgb <-> rgba are the common pairs, pshufb moves four pixels at a time
+  if (src_channels == 3 && dst_channels == 4) {
+    const __m128i shuffle = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+    const __m128i alpha = _mm_set1_epi32(static_cast<int>(0xff000000));
+    for (; i + 6 <= count; i += 4) {
+      __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 3));
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i * 4), _mm_or_si128(_mm_shuffle_epi8(v, shuffle), alpha));
+    }
+  } else if (src_channels == 4 && dst_channels == 3) {
+    const __m128i shuffle = _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+    for (; i + 4 <= count; i += 4) {
+      __m128i v = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 4)), shuffle);
+      _mm_storel_epi64(reinterpret_cast<__m128i*>(dst + i * 3), v);
+      uint32_t tail = static_cast<uint32_t>(_mm_cvtsi128_si32(_mm_srli_si128(v, 8)));
+      std::memcpy(dst + i * 3 + 8, &tail, sizeof(tail));
+    }
+  }
+#endif
+  convert_channels_scalar(src + i * src_channels, src_channels, dst + i * dst_channels, dst_channels, count - i);
+}
+
+void convert_channels(const uint16_t* src, int src_channels, uint16_t* dst, int dst_channels, std::size_t count)
+{
+  convert_channels_scalar(src, src_channels, dst, dst_channels, count);
+}
+
+void convert_channels(const float* src, int src_channels, float* dst, int dst_channels, std::size_t count)
+{
+  convert_channels_scalar(src, src_channels, dst, dst_channels, count);
+}
+
+void swizzle_rb(unsigned char* row, int channels, std::size_t count)
+{
+  if (channels < 3) {
+    return;
+  }
+
+  std::size_t i = 0;
+#if defined(GFX_SSE2)
+  if (channels == 4) {
+    const __m128i ga = _mm_set1_epi32(static_cast<int>(0xff00ff00));
+    const __m128i low = _mm_set1_epi32(0xff);
+    for (; i + 4 <= count; i += 4) {
+      __m128i* p = reinterpret_cast<__m128i*>(row + i * 4);
+      __m128i v = _mm_loadu_si128(p);
+      __m128i r = _mm_and_si128(v, low);
+      __m128i b = _mm_and_si128(_mm_srli_epi32(v, 16), low);
+      _mm_storeu_si128(p, _mm_or_si128(_mm_and_si128(v, ga), _mm_or_si128(_mm_slli_epi32(r, 16), b)));
+    }
+  }
+#endif
+  for (; i < count; i++) {
+    std::swap(row[i * channels], row[i * channels + 2]);
+  }
+}
+
+void premultiply_alpha(unsigned char* row, int channels, std::size_t count)
+{
+  const int alpha = alpha_channel(channels);
+  if (alpha < 0) {
+    return;
+  }
+
+  std::size_t i = 0;
+#if defined(GFX_SSE2)
+  if (channels == 4) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i bias = _mm_set1_epi16(128);
+    const __m128i alpha_lanes = _mm_setr_epi16(0, 0, 0, -1, 0, 0, 0, -1);
+
+    auto multiply = [&](__m128i v) {
+      __m128i a = _mm_shufflehi_epi16(_mm_shufflelo_epi16(v, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+      __m128i x = _mm_add_epi16(_mm_mullo_epi16(v, a), bias);
+      x = _mm_srli_epi16(_mm_add_epi16(x, _mm_srli_epi16(x, 8)), 8);
+      return _mm_or_si128(_mm_and_si128(alpha_lanes, v), _mm_andnot_si128(alpha_lanes, x));
+    };
+
+    for (; i + 4 <= count; i += 4) {
+      __m128i* p = reinterpret_cast<__m128i*>(row + i * 4);
+      __m128i v = _mm_loadu_si128(p);
+      __m128i lo = multiply(_mm_unpacklo_epi8(v, zero));
+      __m128i hi = multiply(_mm_unpackhi_epi8(v, zero));
+      _mm_storeu_si128(p, _mm_packus_epi16(lo, hi));
+    }
+  }
+#endif
+  for (; i < count; i++) {
+    unsigned char* p = row + i * channels;
+    for (int c = 0; c < alpha; c++) {
+      p[c] = static_cast<unsigned char>(div255(p[c] * p[alpha]));
+    }
+  }
+}
+
+void premultiply_alpha(float* row, int channels, std::size_t count)
+{
+  const int alpha = alpha_channel(channels);
+  if (alpha < 0) {
+    return;
+  }
+
+  for (std::size_t i = 0; i < count; i++) {
+    float* p = row + i * channels;
+    for (int c = 0; c < alpha; c++) {
+      p[c] *= p[alpha];
+    }
+  }
+}
+
+void srgb_to_linear(const unsigned char* src, float* dst, int channels, std::size_t count)
+{
+  const TransferTables& tables = transfer_tables();
+  const int alpha = alpha_channel(channels);
+
+  for (std::size_t i = 0; i < count; i++) {
+    for (int c = 0; c < channels; c++) {
+      std::size_t k = i * channels + c;
+      dst[k] = c == alpha ? src[k] * (1.0f / 255.0f) : tables.srgb_to_linear[src[k]];
+    }
+  }
+}
+
+void linear_to_srgb(const float* src, unsigned char* dst, int channels, std::size_t count)
+{
+  const TransferTables& tables = transfer_tables();
+  const int alpha = alpha_channel(channels);
+  const std::size_t values = count * channels;
+
+  std::size_t i = 0;
+#if defined(GFX_SSE2)
+  if (channels == 4) {
+    const __m128 scale = _mm_setr_ps(ENCODE_LUT_SIZE - 1, ENCODE_LUT_SIZE - 1, ENCODE_LUT_SIZE - 1, 255.0f);
+    const __m128 half = _mm_set1_ps(0.5f);
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+    for (; i + 4 <= values; i += 4) {
+      __m128 v = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(src + i), zero), one);
+      alignas(16) int index[4];
+      _mm_store_si128(reinterpret_cast<__m128i*>(index), _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(v, scale), half)));
+      dst[i + 0] = tables.linear_to_srgb[index[0]];
+      dst[i + 1] = tables.linear_to_srgb[index[1]];
+      dst[i + 2] = tables.linear_to_srgb[index[2]];
+      dst[i + 3] = static_cast<unsigned char>(index[3]);
+    }
+  }
+#endif
+  for (; i < values; i++) {
+    float v = saturate(src[i]);
+    if (static_cast<int>(i % channels) == alpha) {
+      dst[i] = static_cast<unsigned char>(v * 255.0f + 0.5f);
+    } else {
+      dst[i] = tables.linear_to_srgb[static_cast<int>(v * (ENCODE_LUT_SIZE - 1) + 0.5f)];
+    }
+  }
+}
+
+void unorm8_to_float(const unsigned char* src, float* dst, std::size_t count)
+{
+  const float scale = 1.0f / 255.0f;
+
+  std::size_t i = 0;
+#if defined(GFX_SSE2)
+  const __m128i zero = _mm_setzero_si128();
+  const __m128 factor = _mm_set1_ps(scale);
+  for (; i + 16 <= count; i += 16) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+    __m128i lo = _mm_unpacklo_epi8(v, zero);
+    __m128i hi = _mm_unpackhi_epi8(v, zero);
+    _mm_storeu_ps(dst + i + 0, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(lo, zero)), factor));
+    _mm_storeu_ps(dst + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(lo, zero)), factor));
+    _mm_storeu_ps(dst + i + 8, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(hi, zero)), factor));
+    _mm_storeu_ps(dst + i + 12, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(hi, zero)), factor));
+  }
+#endif
+  for (; i < count; i++) {
+    dst[i] = src[i] * scale;
+  }
+}
+
+void float_to_unorm8(const float* src, unsigned char* dst, std::size_t count)
+{
+  std::size_t i = 0;
+#if defined(GFX_SSE2)
+  const __m128 zero = _mm_setzero_ps();
+  const __m128 one = _mm_set1_ps(1.0f);
+  const __m128 scale = _mm_set1_ps(255.0f);
+  const __m128 half = _mm_set1_ps(0.5f);
+
+  auto quantize = [&](const float* p) {
+    __m128 v = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(p), zero), one);
+    return _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(v, scale), half));
+  };
+
+  for (; i + 16 <= count; i += 16) {
+    __m128i lo = _mm_packs_epi32(quantize(src + i), quantize(src + i + 4));
+    __m128i hi = _mm_packs_epi32(quantize(src + i + 8), quantize(src + i + 12));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_packus_epi16(lo, hi));
+  }
+#endif
+  for (; i < count; i++) {
+    dst[i] = static_cast<unsigned char>(saturate(src[i]) * 255.0f + 0.5f);
+  }
+}
+
+void unorm16_to_float(const uint16_t* src, float* dst, std::size_t count)
+{
+  const float scale = 1.0f / 65535.0f;
+
+  std::size_t i = 0;
+#if defined(GFX_SSE2)
+  const __m128i zero = _mm_setzero_si128();
+  const __m128 factor = _mm_set1_ps(scale);
+  for (; i + 8 <= count; i += 8) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+    _mm_storeu_ps(dst + i + 0, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(v, zero)), factor));
+    _mm_storeu_ps(dst + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(v, zero)), factor));
+  }
+#endif
+  for (; i < count; i++) {
+    dst[i] = src[i] * scale;
+  }
+}
+
+void float_to_unorm16(const float* src, uint16_t* dst, std::size_t count)
+{
+  for (std::size_t i = 0; i < count; i++) {
+    dst[i] = static_cast<uint16_t>(saturate(src[i]) * 65535.0f + 0.5f);
+  }
+}
+
+uint16_t float_to_half(float value) { return float_to_half_scalar(value); }
+
+float half_to_float(uint16_t value) { return half_to_float_scalar(value); }
+
+void float_to_half(const float* src, uint16_t* dst, std::size_t count)
+{
+  std::size_t i = 0;
+#if defined(GFX_F16C)
+  for (; i + 4 <= count; i += 4) {
+    __m128i h = _mm_cvtps_ph(_mm_loadu_ps(src + i), _MM_FROUND_TO_NEAREST_INT);
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(dst + i), h);
+  }
+#endif
+  for (; i < count; i++) {
+    dst[i] = float_to_half_scalar(src[i]);
+  }
+}
+
+void half_to_float(const uint16_t* src, float* dst, std::size_t count)
+{
+  std::size_t i = 0;
+#if defined(GFX_F16C)
+  for (; i + 4 <= count; i += 4) {
+    __m128i h = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(src + i));
+    _mm_storeu_ps(dst + i, _mm_cvtph_ps(h));
+  }
+#endif
+  for (; i < count; i++) {
+    dst[i] = half_to_float_scalar(src[i]);
+  }
+}
+
+// through a small float buffer so both steps stay vectorized
+void unorm8_to_half(const unsigned char* src, uint16_t* dst, std::size_t count)
+{
+  float buffer[256];
+  for (std::size_t i = 0; i < count; i += 256) {
+    std::size_t n = std::min<std::size_t>(256, count - i);
+    unorm8_to_float(src + i, buffer, n);
+    float_to_half(buffer, dst + i, n);
+  }
+}
+
+void half_to_unorm8(const uint16_t* src, unsigned char* dst, std::size_t count)
+{
+  float buffer[256];
+  for (std::size_t i = 0; i < count; i += 256) {
+    std::size_t n = std::min<std::size_t>(256, count - i);
+    half_to_float(src + i, buffer, n);
+    float_to_unorm8(buffer, dst + i, n);
+  }
+}
+
+}  // namespace gfx
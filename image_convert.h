@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace gfx
+{
+// row kernels behind Image::convert and friends, usable on any pixel rows like strips or mapped files
+//
+// channel counts follow the stb convention: grey, grey + alpha, rgb and rgba, count is in pixels unless noted
+
+// expanding replicates grey and fills alpha with the maximum, contracting to grey uses the stb luma weights
+void convert_channels(const unsigned char* src, int src_channels, unsigned char* dst, int dst_channels,
+                      std::size_t count);
+void convert_channels(const uint16_t* src, int src_channels, uint16_t* dst, int dst_channels, std::size_t count);
+void convert_channels(const float* src, int src_channels, float* dst, int dst_channels, std::size_t count);
+
+// rgb(a) <-> bgr(a) in place
+void swizzle_rb(unsigned char* row, int channels, std::size_t count);
+
+// in place, images without alpha are left alone
+void premultiply_alpha(unsigned char* row, int channels, std::size_t count);
+void premultiply_alpha(float* row, int channels, std::size_t count);
+
+// table based transfer functions, alpha stays linear
+void srgb_to_linear(const unsigned char* src, float* dst, int channels, std::size_t count);
+void linear_to_srgb(const float* src, unsigned char* dst, int channels, std::size_t count);
+
+// normalized value conversion, count is in values
+void unorm8_to_float(const unsigned char* src, float* dst, std::size_t count);
+void float_to_unorm8(const float* src, unsigned char* dst, std::size_t count);
+void unorm16_to_float(const uint16_t* src, float* dst, std::size_t count);
+void float_to_unorm16(const float* src, uint16_t* dst, std::size_t count);
+
+// ieee half floats, F16C when the target has it, the fallback rounds the same way
+void float_to_half(const float* src, uint16_t* dst, std::size_t count);
+void half_to_float(const uint16_t* src, float* dst, std::size_t count);
+void unorm8_to_half(const unsigned char* src, uint16_t* dst, std::size_t count);
+void half_to_unorm8(const uint16_t* src, unsigned char* dst, std::size_t count);
+
+uint16_t float_to_half(float value);
+float half_to_float(uint16_t value);
+}  // namespace gfx
@@ -0,0 +1,241 @@
+#include "image_file.h"
+
+#include <cstring>
+#include <fstream>
+
+#include "block_compression.h"
+#include "image_rows.h"
+
+namespace gfx
+{
+
+static_assert(sizeof(ImageFile::Header) == 64, "the header layout is part of the file format");
+static_assert(sizeof(ImageFile::LevelEntry) == 24, "the level table layout is part of the file format");
+
+namespace
+{
+
+// a mip chain of the largest texture has 32 levels
+constexpr uint32_t MAX_LEVELS = 32;
+
+bool valid_header(const ImageFile::Header& header)
+{
+  static const Image::Format formats[] = {Image::RED, Image::RG, Image::RGB, Image::RGBA};
+
+  if (header.magic != ImageFile::MAGIC || header.version != ImageFile::VERSION || header.levels == 0 ||
+      header.levels > MAX_LEVELS || header.channels == 0 || header.channels > 4 ||
+      header.format != static_cast<uint32_t>(formats[header.channels - 1])) {
+    return false;
+  }
+
+  if (header.width == 0 || header.height == 0 || header.width > INT32_MAX || header.height > INT32_MAX) {
+    return false;
+  }
+
+  if (header.compression != ImageFile::NONE) {
+    // block compressed levels are always written with 8 bit type
+    return CompressedImage::block_size(static_cast<ImageFile::Compression>(header.compression)) != 0 &&
+           header.type == Image::UNSIGNED_BYTE;
+  }
+
+  return header.type == Image::UNSIGNED_BYTE || header.type == Image::UNSIGNED_SHORT ||
+         header.type == Image::HALF_FLOAT || header.type == Image::FLOAT;
+}
+
+// size >= width * height * bytes per pixel or block, divided instead of multiplied so nothing overflows
+bool level_fits(const ImageFile::Header& header, const ImageFile::LevelEntry& entry)
+{
+  uint64_t columns = entry.width, rows = entry.height, unit;
+  if (header.compression != ImageFile::NONE) {
+    columns = (columns + 3) / 4;
+    rows = (rows + 3) / 4;
+    unit = CompressedImage::block_size(static_cast<ImageFile::Compression>(header.compression));
+  } else {
+    unit = static_cast<uint64_t>(header.channels) * detail::type_size(static_cast<Image::Type>(header.type));
+  }
+
+  return entry.size / unit / columns >= rows;
+}
+
+}  // namespace
+
+namespace detail
+{
+
+bool parse_image_file(const unsigned char* data, std::size_t size, ImageFile::Header* header,
+                      std::vector<ImageFile::Level>* levels)
+{
+  using Header = ImageFile::Header;
+  using LevelEntry = ImageFile::LevelEntry;
+
+  levels->clear();
+
+  if (size < sizeof(Header)) {
+    return false;
+  }
+
+  std::memcpy(header, data, sizeof(Header));
+
+  if (!valid_header(*header) || size < sizeof(Header) + sizeof(LevelEntry) * header->levels) {
+    return false;
+  }
+
+  const unsigned char* table = data + sizeof(Header);
+  for (uint32_t i = 0; i < header->levels; i++) {
+    LevelEntry entry;
+    std::memcpy(&entry, table + i * sizeof(LevelEntry), sizeof(entry));
+
+    // level 0 is the image itself, every level has to hold all of its pixels or blocks
+    bool valid = entry.width != 0 && entry.height != 0 && entry.width <= INT32_MAX && entry.height <= INT32_MAX &&
+                 (i != 0 || (entry.width == header->width && entry.height == header->height)) &&
+                 entry.offset >= sizeof(Header) && entry.offset <= size && entry.size <= size - entry.offset &&
+                 level_fits(*header, entry);
+
+    if (!valid) {
+      levels->clear();
+      return false;
+    }
+
+    levels->push_back({static_cast<int>(entry.width), static_cast<int>(entry.height), data + entry.offset,
+                       static_cast<std::size_t>(entry.size)});
+  }
+
+  return true;
+}
+
+}  // namespace detail
+
+ImageFile::ImageFile() noexcept : m_header() {}
+
+bool ImageFile::load(const std::filesystem::path& path)
+{
+  m_file = MappedFile(path);
+  m_header = Header();
+
+  Header header;
+  if (!m_file.is_valid() || !detail::parse_image_file(m_file.data(), m_file.size(), &header, &m_levels)) {
+    m_levels.clear();
+    return false;
+  }
+
+  m_header = header;
+  return true;
+}
+
+bool ImageFile::write(const std::filesystem::path& path, const Image& image)
+{
+  if (!image.is_valid()) {
+    return false;
+  }
+
+  Header header = {};
+  header.width = image.width();
+  header.height = image.height();
+  header.channels = image.channels();
+  header.format = image.format();
+  header.type = image.type();
+  header.compression = NONE;
+
+  return write(path, header, {{image.width(), image.height(), image.data(), image.size_bytes()}});
+}
+
+bool ImageFile::write(const std::filesystem::path& path, const MipChain& mips)
+{
+  if (!mips.is_valid()) {
+    return false;
+  }
+
+  Header header = {};
+  header.width = mips.width();
+  header.height = mips.height();
+  header.channels = mips.channels();
+  header.format = mips.format();
+  header.type = Image::UNSIGNED_BYTE;
+  header.compression = NONE;
+
+  std::vector<Level> levels;
+  for (int i = 0; i < mips.levels(); i++) {
+    levels.push_back({mips.width(i), mips.height(i), mips.data(i), mips.level(i).size});
+  }
+
+  return write(path, header, levels);
+}
+
+bool ImageFile::write(const std::filesystem::path& path, const CompressedImage& image)
+{
+  if (!image.is_valid()) {
+    return false;
+  }
+
+  static const Image::Format formats[] = {Image::RED, Image::RG, Image::RGB, Image::RGBA};
+
+  Header header = {};
+  header.width = image.width();
+  header.height = image.height();
+  header.channels = image.channels();
+  header.format = formats[image.channels() - 1];
+  header.type = Image::UNSIGNED_BYTE;
+  header.compression = image.format();
+
+  std::vector<Level> levels;
+  for (int i = 0; i < image.levels(); i++) {
+    levels.push_back({image.width(i), image.height(i), image.data(i), image.level(i).size});
+  }
+
+  return write(path, header, levels);
+}
+
+bool ImageFile::write(const std::filesystem::path& path, Header header, const std::vector<Level>& levels)
+{
+  std::ofstream file(path, std::ios::binary | std::ios::trunc);
+  if (!file.is_open()) {
+    return false;
+  }
+
+  header.magic = MAGIC;
+  header.version = VERSION;
+  header.levels = static_cast<uint32_t>(levels.size());
+
+  std::vector<LevelEntry> table;
+  uint64_t offset = sizeof(Header) + sizeof(LevelEntry) * levels.size();
+
+  for (const Level& level : levels) {
+    offset = (offset + DATA_ALIGNMENT - 1) / DATA_ALIGNMENT * DATA_ALIGNMENT;
+    table.push_back({static_cast<uint32_t>(level.width), static_cast<uint32_t>(level.height), offset, level.size});
+    offset += level.size;
+  }
+
+  file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  file.write(reinterpret_cast<const char*>(table.data()), sizeof(LevelEntry) * table.size());
+
+  const char padding[DATA_ALIGNMENT] = {};
+  uint64_t position = sizeof(Header) + sizeof(LevelEntry) * levels.size();
+
+  for (std::size_t i = 0; i < levels.size(); i++) {
+    file.write(padding, static_cast<std::streamsize>(table[i].offset - position));
+    file.write(reinterpret_cast<const char*>(levels[i].data), static_cast<std::streamsize>(levels[i].size));
+    position = table[i].offset + table[i].size;
+  }
+
+  return file.good();
+}
+
+int ImageFile::width() const { return m_header.width; }
+
+int ImageFile::height() const { return m_header.height; }
+
+int ImageFile::channels() const { return m_header.channels; }
+
+int ImageFile::levels() const { return static_cast<int>(m_levels.size()); }
+
+Image::Format ImageFile::format() const { return static_cast<Image::Format>(m_header.format); }
+
+Image::Type ImageFile::type() const { return static_cast<Image::Type>(m_header.type); }
+
+ImageFile::Compression ImageFile::compression() const { return static_cast<Compression>(m_header.compression); }
+
+const ImageFile::Level& ImageFile::level(int level) const { return m_levels[level]; }
+
+bool ImageFile::is_valid() const { return !m_levels.empty(); }
+
+}  // namespace gfx
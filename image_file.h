@@ -0,0 +1,98 @@
+#pragma once
+
+#include <GL/glew.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+#include "image.h"
+#include "mapped_file.h"
+#include "mipmap.h"
+
+namespace gfx
+{
+class CompressedImage;
+
+// .gfximg container, pixels are stored ready to upload so loading is a mapping and a pointer fixup
+//
+// layout (little endian):
+//   Header
+//   LevelEntry[levels]
+//   level data, each level starts on a DATA_ALIGNMENT boundary
+class ImageFile
+{
+ public:
+  enum Compression : GLenum {
+    NONE = 0,
+    BC1 = GL_COMPRESSED_RGBA_S3TC_DXT1_EXT,
+    BC3 = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT,
+    BC4 = GL_COMPRESSED_RED_RGTC1,
+    BC5 = GL_COMPRESSED_RG_RGTC2,
+    BC7 = GL_COMPRESSED_RGBA_BPTC_UNORM,
+  };
+
+  struct Level {
+    int width, height;
+    const unsigned char* data;
+    std::size_t size;
+  };
+
+  static constexpr uint32_t MAGIC = 0x49584647;  // "GFXI"
+  static constexpr uint32_t VERSION = 1;
+  static constexpr std::size_t DATA_ALIGNMENT = 64;
+
+  struct Header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t width, height, channels;
+    uint32_t format;       // Image::Format
+    uint32_t type;         // GL pixel type of uncompressed levels
+    uint32_t compression;  // Compression
+    uint32_t levels;
+    uint32_t reserved[7];
+  };
+
+  struct LevelEntry {
+    uint32_t width, height;
+    uint64_t offset, size;  // in bytes from the start of the file
+  };
+
+  ImageFile() noexcept;
+
+  bool load(const std::filesystem::path& path);
+
+  static bool write(const std::filesystem::path& path, const Image& image);
+  static bool write(const std::filesystem::path& path, const MipChain& mips);
+  static bool write(const std::filesystem::path& path, const CompressedImage& image);
+
+  int width() const;
+  int height() const;
+  int channels() const;
+  int levels() const;
+
+  Image::Format format() const;
+  Image::Type type() const;
+  Compression compression() const;
+
+  const Level& level(int level) const;
+
+  bool is_valid() const;
+
+ private:
+  MappedFile m_file;
+  Header m_header;
+  std::vector<Level> m_levels;
+
+  static bool write(const std::filesystem::path& path, Header header, const std::vector<Level>& levels);
+};
+
+namespace detail
+{
+// validates the header and every level of a .gfximg in memory, levels point into data. false for anything
+// ImageFile::load would reject
+bool parse_image_file(const unsigned char* data, std::size_t size, ImageFile::Header* header,
+                      std::vector<ImageFile::Level>* levels);
+}  // namespace detail
+}  // namespace gfx
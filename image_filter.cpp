@@ -0,0 +1,283 @@
+#include "image_filter.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "image_rows.h"
+#include "simd.h"
+#include "thread_pool.h"
+
+namespace gfx
+{
+
+namespace
+{
+
+using detail::load_row;
+using detail::row_grain;
+using detail::store_row;
+
+// source index for i, -1 when it reads as zero
+inline int edge_index(int i, int n, EdgeMode edge)
+{
+  if (0 <= i && i < n) {
+    return i;
+  }
+
+  switch (edge) {
+    case EDGE_WRAP:
+      return ((i % n) + n) % n;
+    case EDGE_MIRROR: {
+      int m = ((i % (2 * n)) + 2 * n) % (2 * n);
+      return m < n ? m : 2 * n - 1 - m;
+    }
+    case EDGE_ZERO:
+      return -1;
+    default:
+      return std::clamp(i, 0, n - 1);
+  }
+}
+
+// out[i] += weight * in[i]
+void madd(float* out, const float* in, float weight, std::size_t count)
+{
+  std::size_t i = 0;
+#if defined(GFX_AVX2)
+  const __m256 w8 = _mm256_set1_ps(weight);
+  for (; i + 8 <= count; i += 8) {
+    __m256 v = _mm256_add_ps(_mm256_loadu_ps(out + i), _mm256_mul_ps(_mm256_loadu_ps(in + i), w8));
+    _mm256_storeu_ps(out + i, v);
+  }
+#endif
+#if defined(GFX_SSE2)
+  const __m128 w4 = _mm_set1_ps(weight);
+  for (; i + 4 <= count; i += 4) {
+    _mm_storeu_ps(out + i, _mm_add_ps(_mm_loadu_ps(out + i), _mm_mul_ps(_mm_loadu_ps(in + i), w4)));
+  }
+#endif
+  for (; i < count; i++) {
+    out[i] += in[i] * weight;
+  }
+}
+
+// out[i] += add[i] - sub[i], either input may be missing
+void slide(float* out, const float* add, const float* sub, std::size_t count)
+{
+  if (add) madd(out, add, 1.0f, count);
+  if (sub) madd(out, sub, -1.0f, count);
+}
+
+// row y of the image in float with left and right pixels of border around it
+void load_padded_row(const ImageView& image, int y, float* padded, int left, int right, EdgeMode edge)
+{
+  const int width = image.width();
+  const int channels = image.channels();
+  const int size = image.bytes_per_pixel() / channels;
+
+  load_row(image.row(y), image.type(), padded + static_cast<std::size_t>(left) * channels,
+              static_cast<std::size_t>(width) * channels);
+
+  for (int x = -left; x < width + right; x++) {
+    if (0 <= x && x < width) continue;
+    float* dst = padded + static_cast<std::size_t>(x + left) * channels;
+    int src = edge_index(x, width, edge);
+    if (src < 0) {
+      std::fill(dst, dst + channels, 0.0f);
+    } else {
+      load_row(image.row(y) + static_cast<std::size_t>(src) * channels * size, image.type(), dst, channels);
+    }
+  }
+}
+
+}  // namespace
+
+Image convolve(const ImageView& image, const std::vector<float>& horizontal, const std::vector<float>& vertical,
+               EdgeMode edge)
+{
+  if (!image.is_valid() || horizontal.empty() || vertical.empty()) {
+    return Image();
+  }
+
+  const int width = image.width(), height = image.height(), channels = image.channels();
+  const std::size_t n = static_cast<std::size_t>(width) * channels;
+
+  Image result(width, height, channels, image.type());
+  if (!result.is_valid()) {
+    return result;
+  }
+
+  std::vector<float> rows(n * height);
+  const int left = static_cast<int>(horizontal.size() / 2);
+  const int right = static_cast<int>(horizontal.size()) - 1 - left;
+
+  ThreadPool::global().parallel_for(
+      0, height,
+      [&](int begin, int end) {
+        std::vector<float> padded(static_cast<std::size_t>(width + left + right) * channels);
+        for (int y = begin; y < end; y++) {
+          load_padded_row(image, y, padded.data(), left, right, edge);
+          float* out = rows.data() + y * n;
+          std::fill(out, out + n, 0.0f);
+          for (std::size_t i = 0; i < horizontal.size(); i++) {
+            madd(out, padded.data() + i * channels, horizontal[i], n);
+          }
+        }
+      },
+      row_grain(n));
+
+  const int top = static_cast<int>(vertical.size() / 2);
+  const std::size_t stride = static_cast<std::size_t>(width) * result.bytes_per_pixel();
+
+  ThreadPool::global().parallel_for(
+      0, height,
+      [&](int begin, int end) {
+        std::vector<float> out(n);
+        for (int y = begin; y < end; y++) {
+          std::fill(out.begin(), out.end(), 0.0f);
+          for (std::size_t i = 0; i < vertical.size(); i++) {
+            int src = edge_index(y + static_cast<int>(i) - top, height, edge);
+            if (src >= 0) {
+              madd(out.data(), rows.data() + src * n, vertical[i], n);
+            }
+          }
+          store_row(out.data(), result.type(), result.data() + y * stride, n);
+        }
+      },
+      row_grain(n));
+
+  return result;
+}
+
+Image convolve(const ImageView& image, const std::vector<float>& kernel, EdgeMode edge)
+{
+  return convolve(image, kernel, kernel, edge);
+}
+
+Image box_blur(const ImageView& image, int radius, EdgeMode edge)
+{
+  if (!image.is_valid()) {
+    return Image();
+  }
+  if (radius <= 0) {
+    return image.copy();
+  }
+
+  const int width = image.width(), height = image.height(), channels = image.channels();
+  const std::size_t n = static_cast<std::size_t>(width) * channels;
+  const float scale = 1.0f / (2 * radius + 1);
+
+  Image result(width, height, channels, image.type());
+  if (!result.is_valid()) {
+    return result;
+  }
+
+  // horizontal sums slide along each row, one pixel in and one out per step
+  std::vector<float> rows(n * height);
+
+  ThreadPool::global().parallel_for(
+      0, height,
+      [&](int begin, int end) {
+        std::vector<float> padded(static_cast<std::size_t>(width + 2 * radius) * channels);
+        std::vector<float> sum(channels);
+        for (int y = begin; y < end; y++) {
+          load_padded_row(image, y, padded.data(), radius, radius, edge);
+          const float* p = padded.data();
+          float* out = rows.data() + y * n;
+
+          std::fill(sum.begin(), sum.end(), 0.0f);
+          for (int i = 0; i < 2 * radius + 1; i++) {
+            for (int c = 0; c < channels; c++) {
+              sum[c] += p[i * channels + c];
+            }
+          }
+
+          int x = 0;
+#if defined(GFX_SSE2)
+          if (channels == 4) {
+            __m128 s = _mm_loadu_ps(sum.data());
+            const __m128 k = _mm_set1_ps(scale);
+            for (; x < width; x++) {
+              _mm_storeu_ps(out + x * 4, _mm_mul_ps(s, k));
+              if (x + 1 < width) {
+                s = _mm_add_ps(s, _mm_loadu_ps(p + (x + 2 * radius + 1) * 4));
+                s = _mm_sub_ps(s, _mm_loadu_ps(p + x * 4));
+              }
+            }
+          }
+#endif
+          for (; x < width; x++) {
+            for (int c = 0; c < channels; c++) {
+              out[x * channels + c] = sum[c] * scale;
+              if (x + 1 < width) {
+                sum[c] += p[(x + 2 * radius + 1) * channels + c];
+                sum[c] -= p[x * channels + c];
+              }
+            }
+          }
+        }
+      },
+      row_grain(n));
+
+  // vertical sums run down columns, so threads take strips of columns and slide a whole strip row at a time
+  constexpr std::size_t STRIP = 1024;
+  const int strips = static_cast<int>((n + STRIP - 1) / STRIP);
+  const std::size_t stride = static_cast<std::size_t>(width) * result.bytes_per_pixel();
+  const std::size_t value_size = result.bytes_per_pixel() / channels;
+
+  ThreadPool::global().parallel_for(0, strips, [&](int begin, int end) {
+    std::vector<float> sum(STRIP), out(STRIP);
+    for (int strip = begin; strip < end; strip++) {
+      const std::size_t first = strip * STRIP;
+      const std::size_t count = std::min(STRIP, n - first);
+      auto row = [&](int y) {
+        int src = edge_index(y, height, edge);
+        return src < 0 ? nullptr : rows.data() + src * n + first;
+      };
+
+      std::fill(sum.begin(), sum.end(), 0.0f);
+      for (int i = -radius; i <= radius; i++) {
+        slide(sum.data(), row(i), nullptr, count);
+      }
+
+      for (int y = 0; y < height; y++) {
+        std::fill(out.begin(), out.begin() + count, 0.0f);
+        madd(out.data(), sum.data(), scale, count);
+        store_row(out.data(), result.type(), result.data() + y * stride + first * value_size, count);
+        if (y + 1 < height) {
+          slide(sum.data(), row(y + radius + 1), row(y - radius), count);
+        }
+      }
+    }
+  });
+
+  return result;
+}
+
+Image gaussian_blur(const ImageView& image, float sigma, int radius, EdgeMode edge)
+{
+  return convolve(image, gaussian_kernel(sigma, radius), edge);
+}
+
+std::vector<float> gaussian_kernel(float sigma, int radius)
+{
+  if (sigma <= 0.0f) {
+    return {1.0f};
+  }
+  if (radius <= 0) {
+    radius = std::max(1, static_cast<int>(std::ceil(3.0f * sigma)));
+  }
+
+  std::vector<float> kernel(2 * radius + 1);
+  float sum = 0.0f;
+  for (int i = -radius; i <= radius; i++) {
+    kernel[i + radius] = std::exp(-(i * i) / (2.0f * sigma * sigma));
+    sum += kernel[i + radius];
+  }
+  for (float& w : kernel) {
+    w /= sum;
+  }
+
+  return kernel;
+}
+
+}  // namespace gfx
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <vector>
+
+#include "image.h"
+#include "image_view.h"
+
+namespace gfx
+{
+// how pixels outside the image are read, mirror repeats the edge pixel like GL_MIRRORED_REPEAT
+enum EdgeMode { EDGE_CLAMP, EDGE_WRAP, EDGE_MIRROR, EDGE_ZERO };
+
+// separable filters, the result has the size, channels and type of the source
+//
+// filtering happens in float, a horizontal pass into a float image and a vertical pass back, rows are split across
+// the shared thread pool and the inner loops run over whole rows so they vectorize for any channel count
+
+// kernels are centered on their middle element and applied as given, without normalization
+Image convolve(const ImageView& image, const std::vector<float>& horizontal, const std::vector<float>& vertical,
+               EdgeMode edge = EDGE_CLAMP);
+Image convolve(const ImageView& image, const std::vector<float>& kernel, EdgeMode edge = EDGE_CLAMP);
+
+// mean of the (2 radius + 1)^2 pixels around each pixel, running sums make the cost independent of the radius
+Image box_blur(const ImageView& image, int radius, EdgeMode edge = EDGE_CLAMP);
+
+// radius 0 picks one that covers 3 sigma
+Image gaussian_blur(const ImageView& image, float sigma, int radius = 0, EdgeMode edge = EDGE_CLAMP);
+
+// normalized weights, 2 radius + 1 of them
+std::vector<float> gaussian_kernel(float sigma, int radius = 0);
+}  // namespace gfx
@@ -0,0 +1,69 @@
+#include "image_rows.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+#include "image_convert.h"
+
+namespace gfx
+{
+namespace detail
+{
+
+int type_size(Image::Type type)
+{
+  switch (type) {
+    case Image::UNSIGNED_SHORT:
+    case Image::HALF_FLOAT:
+      return 2;
+    case Image::FLOAT:
+      return 4;
+    default:
+      return 1;
+  }
+}
+
+void load_row(const unsigned char* src, Image::Type type, float* dst, std::size_t count)
+{
+  switch (type) {
+    case Image::UNSIGNED_SHORT:
+      unorm16_to_float(reinterpret_cast<const uint16_t*>(src), dst, count);
+      break;
+    case Image::HALF_FLOAT:
+      half_to_float(reinterpret_cast<const uint16_t*>(src), dst, count);
+      break;
+    case Image::FLOAT:
+      std::memcpy(dst, src, count * sizeof(float));
+      break;
+    default:
+      unorm8_to_float(src, dst, count);
+      break;
+  }
+}
+
+void store_row(const float* src, Image::Type type, unsigned char* dst, std::size_t count)
+{
+  switch (type) {
+    case Image::UNSIGNED_SHORT:
+      float_to_unorm16(src, reinterpret_cast<uint16_t*>(dst), count);
+      break;
+    case Image::HALF_FLOAT:
+      float_to_half(src, reinterpret_cast<uint16_t*>(dst), count);
+      break;
+    case Image::FLOAT:
+      std::memcpy(dst, src, count * sizeof(float));
+      break;
+    default:
+      float_to_unorm8(src, dst, count);
+      break;
+  }
+}
+
+int row_grain(std::size_t values_per_row)
+{
+  return std::max(1, static_cast<int>((64 * 1024) / std::max<std::size_t>(values_per_row, 1)));
+}
+
+}  // namespace detail
+}  // namespace gfx
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstddef>
+
+#include "image.h"
+
+namespace gfx
+{
+namespace detail
+{
+// helpers the row kernels of the library share, not part of the public interface
+
+// bytes per channel value
+int type_size(Image::Type type);
+
+// values of any type to float and back, 8 and 16 bit values map to [0, 1] like Image::convert, half float and float
+// values stay as they are. count is in values
+void load_row(const unsigned char* src, Image::Type type, float* dst, std::size_t count);
+void store_row(const float* src, Image::Type type, unsigned char* dst, std::size_t count);
+
+// rows per ThreadPool::parallel_for chunk so that a chunk touches about 64k values or bytes, small images are not
+// worth waking the pool for
+int row_grain(std::size_t values_per_row);
+
+// scalar twins of _mm_min_ps and _mm_max_ps including their NaN behaviour, b is returned when either is NaN, so
+// scalar fallbacks return the same bits as the SIMD kernels
+inline float min_ps(float a, float b) { return a < b ? a : b; }
+
+inline float max_ps(float a, float b) { return a > b ? a : b; }
+}  // namespace detail
+}  // namespace gfx
@@ -0,0 +1,294 @@
+#include "image_stats.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <mutex>
+
+#include "image_rows.h"
+#include "simd.h"
+#include "thread_pool.h"
+
+namespace gfx
+{
+
+namespace
+{
+
+using detail::load_row;
+using detail::max_ps;
+using detail::min_ps;
+using detail::row_grain;
+
+// sums of the differences to a shift close to the data, the first pixel of the chunk, so the variance does not come
+// from subtracting two large numbers
+struct Partial {
+  float min[4], max[4];
+  double shift[4], sum[4], sum_sq[4];
+
+  Partial()
+  {
+    for (int c = 0; c < 4; c++) {
+      min[c] = std::numeric_limits<float>::infinity();
+      max[c] = -std::numeric_limits<float>::infinity();
+      shift[c] = sum[c] = sum_sq[c] = 0.0;
+    }
+  }
+};
+
+// one row of values into the partial results, differences are taken and summed in double
+void reduce_row(const float* row, std::size_t count, int channels, Partial& partial)
+{
+  std::size_t i = 0;
+
+#if defined(GFX_SSE2)
+  // 4 floats hold whole pixels for 1, 2 and 4 channels, 3 channels line up again after 12
+  const int registers = channels == 3 ? 3 : 1;
+  const std::size_t step = 4 * registers;
+
+  __m128 vmin[3], vmax[3];
+  __m128d shift[3][2], sum[3][2], sq[3][2];
+  for (int r = 0; r < 3; r++) {
+    vmin[r] = _mm_set1_ps(std::numeric_limits<float>::infinity());
+    vmax[r] = _mm_set1_ps(-std::numeric_limits<float>::infinity());
+    for (int h = 0; h < 2; h++) {
+      const int lane = r * 4 + h * 2;
+      shift[r][h] = _mm_setr_pd(partial.shift[lane % channels], partial.shift[(lane + 1) % channels]);
+      sum[r][h] = sq[r][h] = _mm_setzero_pd();
+    }
+  }
+
+  for (; i + step <= count; i += step) {
+    for (int r = 0; r < registers; r++) {
+      __m128 v = _mm_loadu_ps(row + i + r * 4);
+      vmin[r] = _mm_min_ps(v, vmin[r]);
+      vmax[r] = _mm_max_ps(v, vmax[r]);
+      __m128d d[2] = {_mm_sub_pd(_mm_cvtps_pd(v), shift[r][0]),
+                      _mm_sub_pd(_mm_cvtps_pd(_mm_movehl_ps(v, v)), shift[r][1])};
+      for (int h = 0; h < 2; h++) {
+        sum[r][h] = _mm_add_pd(sum[r][h], d[h]);
+        sq[r][h] = _mm_add_pd(sq[r][h], _mm_mul_pd(d[h], d[h]));
+      }
+    }
+  }
+
+  for (int r = 0; r < registers; r++) {
+    alignas(16) float lanes[2][4];
+    alignas(16) double sums[2][4];
+    _mm_store_ps(lanes[0], vmin[r]);
+    _mm_store_ps(lanes[1], vmax[r]);
+    for (int h = 0; h < 2; h++) {
+      _mm_store_pd(sums[0] + h * 2, sum[r][h]);
+      _mm_store_pd(sums[1] + h * 2, sq[r][h]);
+    }
+    for (int j = 0; j < 4; j++) {
+      int c = (r * 4 + j) % channels;
+      partial.min[c] = min_ps(lanes[0][j], partial.min[c]);
+      partial.max[c] = max_ps(lanes[1][j], partial.max[c]);
+      partial.sum[c] += sums[0][j];
+      partial.sum_sq[c] += sums[1][j];
+    }
+  }
+#endif
+
+  for (; i < count; i++) {
+    int c = static_cast<int>(i % channels);
+    float v = row[i];
+    double d = static_cast<double>(v) - partial.shift[c];
+    partial.min[c] = min_ps(v, partial.min[c]);
+    partial.max[c] = max_ps(v, partial.max[c]);
+    partial.sum[c] += d;
+    partial.sum_sq[c] += d * d;
+  }
+}
+
+// bin = clamp(int((v - min_value) * scale), 0, bins - 1), the same rule as the gpu histogram
+void bin_row(const float* row, std::size_t count, int channels, int bins, float min_value, float scale,
+             uint64_t* counts)
+{
+  std::size_t i = 0;
+  const float last = static_cast<float>(bins - 1);
+
+#if defined(GFX_SSE2)
+  const __m128 offset = _mm_set1_ps(min_value), s = _mm_set1_ps(scale);
+  const __m128 zero = _mm_setzero_ps(), top = _mm_set1_ps(last);
+  for (; i + 4 <= count; i += 4) {
+    __m128 v = _mm_loadu_ps(row + i);
+    // clamping in float first keeps huge values and infinities away from the integer conversion
+    __m128 t = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_sub_ps(v, offset), s), zero), top);
+    alignas(16) int index[4];
+    _mm_store_si128(reinterpret_cast<__m128i*>(index), _mm_cvttps_epi32(t));
+    int valid = _mm_movemask_ps(_mm_cmpord_ps(v, v));
+    for (int j = 0; j < 4; j++) {
+      if (valid & (1 << j)) {
+        counts[static_cast<std::size_t>((i + j) % channels) * bins + index[j]]++;
+      }
+    }
+  }
+#endif
+
+  for (; i < count; i++) {
+    float v = row[i];
+    if (v != v) continue;
+    float t = min_ps(max_ps((v - min_value) * scale, 0.0f), last);
+    counts[static_cast<std::size_t>(i % channels) * bins + static_cast<int>(t)]++;
+  }
+}
+
+}  // namespace
+
+bool statistics(const ImageView& image, ImageStatistics& stats)
+{
+  stats = ImageStatistics();
+  if (!image.is_valid() || image.channels() > 4) {
+    return false;
+  }
+
+  const int channels = image.channels();
+  const std::size_t values = static_cast<std::size_t>(image.width()) * channels;
+
+  // chunks are merged with the parallel variant of Welford's update (Chan et al.)
+  std::mutex mutex;
+  float min[4], max[4];
+  double mean[4] = {0.0, 0.0, 0.0, 0.0}, m2[4] = {0.0, 0.0, 0.0, 0.0}, count = 0.0;
+  for (int c = 0; c < 4; c++) {
+    min[c] = std::numeric_limits<float>::infinity();
+    max[c] = -std::numeric_limits<float>::infinity();
+  }
+
+  ThreadPool::global().parallel_for(
+      0, image.height(),
+      [&](int begin, int end) {
+        std::vector<float> row(values);
+        Partial partial;
+        for (int y = begin; y < end; y++) {
+          load_row(image.row(y), image.type(), row.data(), values);
+          if (y == begin) {
+            for (int c = 0; c < channels; c++) partial.shift[c] = row[c];
+          }
+          reduce_row(row.data(), values, channels, partial);
+        }
+
+        const double n = static_cast<double>(end - begin) * image.width();
+        std::lock_guard<std::mutex> lock(mutex);
+        const double total = count + n;
+        for (int c = 0; c < channels; c++) {
+          min[c] = min_ps(partial.min[c], min[c]);
+          max[c] = max_ps(partial.max[c], max[c]);
+
+          const double offset = partial.sum[c] / n;
+          const double chunk_mean = partial.shift[c] + offset;
+          const double chunk_m2 = std::max(0.0, partial.sum_sq[c] - partial.sum[c] * offset);
+          const double delta = chunk_mean - mean[c];
+          mean[c] += delta * (n / total);
+          m2[c] += chunk_m2 + delta * delta * (count * n / total);
+        }
+        count = total;
+      },
+      row_grain(values));
+
+  stats.channels = channels;
+  for (int c = 0; c < channels; c++) {
+    stats.min[c] = min[c];
+    stats.max[c] = max[c];
+    stats.mean[c] = mean[c];
+    stats.variance[c] = m2[c] / count;
+  }
+
+  return true;
+}
+
+std::vector<uint64_t> histogram(const ImageView& image, int bins, float min_value, float max_value)
+{
+  if (!image.is_valid() || bins < 1 || !(min_value < max_value)) {
+    return {};
+  }
+
+  const int channels = image.channels();
+  const std::size_t values = static_cast<std::size_t>(image.width()) * channels;
+  const std::size_t size = static_cast<std::size_t>(bins) * channels;
+  const float scale = static_cast<float>(bins) / (max_value - min_value);
+
+  // 8 bit values with one bin each are counted directly
+  const bool direct = image.type() == Image::UNSIGNED_BYTE && bins == 256 && min_value == 0.0f && max_value == 1.0f;
+
+  std::mutex mutex;
+  std::vector<uint64_t> counts(size, 0);
+
+  ThreadPool::global().parallel_for(
+      0, image.height(),
+      [&](int begin, int end) {
+        std::vector<uint64_t> local(size, 0);
+        std::vector<float> row(direct ? 0 : values);
+        for (int y = begin; y < end; y++) {
+          if (direct) {
+            const unsigned char* p = image.row(y);
+            for (std::size_t i = 0; i < values; i++) {
+              local[(i % channels) * 256 + p[i]]++;
+            }
+          } else {
+            load_row(image.row(y), image.type(), row.data(), values);
+            bin_row(row.data(), values, channels, bins, min_value, scale, local.data());
+          }
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        for (std::size_t i = 0; i < size; i++) {
+          counts[i] += local[i];
+        }
+      },
+      row_grain(values));
+
+  return counts;
+}
+
+std::vector<float> luminance_percentiles(const ImageView& image, const std::vector<float>& percentiles)
+{
+  if (!image.is_valid() || image.channels() > 4) {
+    return std::vector<float>(percentiles.size(), 0.0f);
+  }
+
+  const int width = image.width(), channels = image.channels();
+  const std::size_t values = static_cast<std::size_t>(width) * channels;
+  std::vector<float> luminance(static_cast<std::size_t>(width) * image.height());
+
+  ThreadPool::global().parallel_for(
+      0, image.height(),
+      [&](int begin, int end) {
+        std::vector<float> row(values);
+        for (int y = begin; y < end; y++) {
+          load_row(image.row(y), image.type(), row.data(), values);
+          float* out = luminance.data() + static_cast<std::size_t>(y) * width;
+          if (channels >= 3) {
+            for (int x = 0; x < width; x++) {
+              const float* p = row.data() + x * channels;
+              out[x] = 0.2126f * p[0] + 0.7152f * p[1] + 0.0722f * p[2];
+            }
+          } else {
+            for (int x = 0; x < width; x++) {
+              out[x] = row[x * channels];
+            }
+          }
+        }
+      },
+      row_grain(values));
+
+  // selection instead of a full sort, linear per percentile
+  std::vector<float> result;
+  const std::size_t last = luminance.size() - 1;
+  for (float p : percentiles) {
+    const double position = std::clamp(static_cast<double>(p), 0.0, 1.0) * static_cast<double>(last);
+    const std::size_t lo = static_cast<std::size_t>(position);
+    std::nth_element(luminance.begin(), luminance.begin() + lo, luminance.end());
+    float value = luminance[lo];
+    if (lo < last) {
+      float next = *std::min_element(luminance.begin() + lo + 1, luminance.end());
+      value += (next - value) * static_cast<float>(position - static_cast<double>(lo));
+    }
+    result.push_back(value);
+  }
+
+  return result;
+}
+
+}  // namespace gfx
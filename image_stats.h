@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "image.h"
+#include "image_view.h"
+
+namespace gfx
+{
+// reductions over whole images, rows are split across the shared thread pool and every row is reduced with SSE
+//
+// 8 and 16 bit values are normalized to [0, 1] first, half float and float values are taken as they are, like
+// Image::convert does
+
+struct ImageStatistics {
+  int channels;
+  float min[4], max[4];
+  double mean[4], variance[4];  // population variance
+};
+
+// false for invalid images or more than 4 channels
+bool statistics(const ImageView& image, ImageStatistics& stats);
+
+// counts of every channel in bins equal ranges over [min_value, max_value], channel c starts at c * bins. values
+// outside the range land in the first or last bin, NaNs are not counted
+std::vector<uint64_t> histogram(const ImageView& image, int bins = 256, float min_value = 0.0f,
+                                float max_value = 1.0f);
+
+// exact percentiles in [0, 1] of the rec. 709 luminance of rgb(a) images or of the grey channel, interpolated
+// between neighbouring pixels, e.g. {0.5f, 0.95f} for the median and the highlights an exposure pass adapts to
+std::vector<float> luminance_percentiles(const ImageView& image, const std::vector<float>& percentiles);
+}  // namespace gfx
@@ -0,0 +1,259 @@
+#include "image_stream.h"
+
+#include <algorithm>
+#include <cctype>
+
+#include "image_convert.h"
+#include "image_file.h"
+#include "image_rows.h"
+
+namespace gfx
+{
+
+namespace
+{
+
+using detail::type_size;
+
+// level 0 of an uncompressed .gfximg, returns the offset of its pixels or 0. the file is validated like
+// ImageFile::load does
+std::size_t parse_image_file_header(const MappedFile& file, int* width, int* height, int* channels, Image::Type* type)
+{
+  ImageFile::Header header;
+  std::vector<ImageFile::Level> levels;
+
+  if (!detail::parse_image_file(file.data(), file.size(), &header, &levels) || header.compression != ImageFile::NONE) {
+    return 0;
+  }
+
+  *width = levels[0].width;
+  *height = levels[0].height;
+  *channels = static_cast<int>(header.channels);
+  *type = static_cast<Image::Type>(header.type);
+  return static_cast<std::size_t>(levels[0].data - file.data());
+}
+
+}  // namespace
+
+namespace detail
+{
+
+std::size_t parse_pnm_header(const unsigned char* data, std::size_t size, int* width, int* height, int* channels)
+{
+  if (size < 2 || data[0] != 'P' || (data[1] != '5' && data[1] != '6')) {
+    return 0;
+  }
+
+  *channels = data[1] == '6' ? 3 : 1;
+
+  std::size_t i = 2;
+  int values[3];
+
+  for (int& value : values) {
+    // whitespace and comments
+    while (i < size && (std::isspace(data[i]) || data[i] == '#')) {
+      if (data[i] == '#') {
+        while (i < size && data[i] != '\n') i++;
+      } else {
+        i++;
+      }
+    }
+
+    if (i >= size || !std::isdigit(data[i])) {
+      return 0;
+    }
+
+    value = 0;
+    while (i < size && std::isdigit(data[i]) && value < (1 << 24)) {
+      value = value * 10 + (data[i++] - '0');
+    }
+  }
+
+  // exactly one whitespace character separates the header from the pixels
+  if (i >= size || !std::isspace(data[i])) {
+    return 0;
+  }
+  i++;
+
+  *width = values[0];
+  *height = values[1];
+
+  if (values[2] != 255 || *width <= 0 || *height <= 0 ||
+      (size - i) / *channels / *width < static_cast<std::size_t>(*height)) {
+    return 0;
+  }
+
+  return i;
+}
+
+}  // namespace detail
+
+ImageStream::ImageStream() noexcept
+    : m_pixels(nullptr),
+      m_offset(0),
+      m_width(0),
+      m_height(0),
+      m_channels(0),
+      m_channels_in_file(0),
+      m_type(Image::UNSIGNED_BYTE)
+{
+}
+
+bool ImageStream::open(const std::filesystem::path& path, int channels)
+{
+  *this = ImageStream();
+
+  if (channels < 0 || channels > 4) {
+    return false;
+  }
+
+  MappedFile file(path);
+  if (!file.is_valid()) {
+    return false;
+  }
+
+  int width = 0, height = 0, channels_in_file = 0;
+  Image::Type type = Image::UNSIGNED_BYTE;
+
+  std::size_t offset = detail::parse_pnm_header(file.data(), file.size(), &width, &height, &channels_in_file);
+  if (offset == 0) {
+    offset = parse_image_file_header(file, &width, &height, &channels_in_file, &type);
+  }
+
+  if (offset != 0) {
+    // only 8 bit rows have a channel conversion
+    if (type != Image::UNSIGNED_BYTE && channels != Image::NATIVE_CHANNELS && channels != channels_in_file) {
+      return false;
+    }
+    m_pixels = file.data() + offset;
+    m_offset = offset;
+    m_file = std::move(file);
+  } else {
+    // the decoder needs the whole file anyway
+    m_image = Image(file.data(), static_cast<int>(std::min<std::size_t>(file.size(), INT32_MAX)), channels);
+    if (!m_image.is_valid()) {
+      return false;
+    }
+    m_pixels = m_image.data();
+    width = m_image.width();
+    height = m_image.height();
+    channels_in_file = m_image.channels();
+  }
+
+  m_width = width;
+  m_height = height;
+  m_channels_in_file = channels_in_file;
+  m_channels = channels == Image::NATIVE_CHANNELS ? channels_in_file : channels;
+  m_type = type;
+  return true;
+}
+
+bool ImageStream::read(int strip_height, const Callback& callback) const
+{
+  if (!is_valid() || strip_height <= 0) {
+    return false;
+  }
+
+  strip_height = std::min(strip_height, m_height);
+
+  const std::size_t src_stride = static_cast<std::size_t>(m_width) * m_channels_in_file * type_size(m_type);
+  const std::size_t dst_stride = static_cast<std::size_t>(m_width) * m_channels * type_size(m_type);
+
+  // only needed when the channels change, otherwise strips view the file directly
+  std::vector<unsigned char> buffer;
+  if (m_channels != m_channels_in_file) {
+    buffer.resize(dst_stride * strip_height);
+  }
+
+  for (int y = 0; y < m_height; y += strip_height) {
+    const int rows = std::min(strip_height, m_height - y);
+    unsigned char* src = m_pixels + y * src_stride;
+
+    ImageView strip;
+    if (buffer.empty()) {
+      strip = ImageView(src, m_width, rows, m_channels, src_stride, m_type);
+    } else {
+      for (int r = 0; r < rows; r++) {
+        convert_channels(src + r * src_stride, m_channels_in_file, buffer.data() + r * dst_stride, m_channels,
+                         m_width);
+      }
+      strip = ImageView(buffer.data(), m_width, rows, m_channels, dst_stride, m_type);
+    }
+
+    bool more = callback(strip, y);
+
+    if (m_file.is_valid()) {
+      m_file.release(m_offset + y * src_stride, rows * src_stride);
+    }
+
+    if (!more) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+int ImageStream::width() const { return m_width; }
+
+int ImageStream::height() const { return m_height; }
+
+int ImageStream::channels() const { return m_channels; }
+
+Image::Type ImageStream::type() const { return m_type; }
+
+bool ImageStream::streamed() const { return m_file.is_valid(); }
+
+bool ImageStream::is_valid() const { return m_pixels != nullptr; }
+
+StripDownsampler::StripDownsampler(int width, int height, int channels, int factor)
+    : m_width(width), m_height(height), m_factor(std::max(factor, 1)), m_rows(0)
+{
+  if (width > 0 && height > 0 && 0 < channels && channels <= 4) {
+    m_result = Image((width + m_factor - 1) / m_factor, (height + m_factor - 1) / m_factor, channels);
+    m_sums.resize(static_cast<std::size_t>(m_result.width()) * channels);
+  }
+}
+
+void StripDownsampler::add(const ImageView& strip)
+{
+  if (!m_result.is_valid() || !strip.is_valid() || strip.type() != Image::UNSIGNED_BYTE ||
+      strip.channels() != m_result.channels() || strip.width() != m_width) {
+    return;
+  }
+
+  const int channels = m_result.channels();
+  const int out_width = m_result.width();
+
+  for (int r = 0; r < strip.height() && m_rows < m_height; r++, m_rows++) {
+    const unsigned char* row = strip.row(r);
+
+    for (int x = 0; x < m_width; x++) {
+      uint32_t* sum = m_sums.data() + (x / m_factor) * channels;
+      for (int c = 0; c < channels; c++) {
+        sum[c] += row[x * channels + c];
+      }
+    }
+
+    // a block row is done once factor source rows are in, or at the bottom edge
+    const int rows_in_block = m_rows % m_factor + 1;
+    if (rows_in_block != m_factor && m_rows + 1 != m_height) {
+      continue;
+    }
+
+    unsigned char* out = m_result.data() + static_cast<std::size_t>(m_rows / m_factor) * out_width * channels;
+    for (int x = 0; x < out_width; x++) {
+      const uint32_t count = static_cast<uint32_t>(std::min(m_factor, m_width - x * m_factor) * rows_in_block);
+      for (int c = 0; c < channels; c++) {
+        out[x * channels + c] = static_cast<unsigned char>((m_sums[x * channels + c] + count / 2) / count);
+      }
+    }
+    std::fill(m_sums.begin(), m_sums.end(), 0);
+  }
+}
+
+const Image& StripDownsampler::result() const { return m_result; }
+
+Image StripDownsampler::release() { return std::move(m_result); }
+
+}  // namespace gfx
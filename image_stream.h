@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <vector>
+
+#include "image.h"
+#include "image_view.h"
+#include "mapped_file.h"
+
+namespace gfx
+{
+// reads an image top to bottom as horizontal strips, each strip is handed to a callback once
+//
+// binary 8 bit pnm and uncompressed .gfximg files are read straight from a mapping and the pages of finished strips
+// are dropped again, so memory stays at a few strips whatever the image size. stb can not decode other formats in
+// parts, those are decoded whole first and only then split into strips
+//
+// strips can go straight to the GPU with gl::Texture::allocate() and set_sub_image(strip, 0, y)
+class ImageStream
+{
+ public:
+  // return false to stop reading
+  using Callback = std::function<bool(const ImageView& strip, int y)>;
+
+  ImageStream() noexcept;
+
+  // channel conversion is done per strip for 8 bit images, other types are read with the channels of the file
+  bool open(const std::filesystem::path& path, int channels = Image::NATIVE_CHANNELS);
+
+  // true when every strip was delivered, strips are only valid during the callback
+  bool read(int strip_height, const Callback& callback) const;
+
+  int width() const;
+  int height() const;
+  int channels() const;
+  Image::Type type() const;
+
+  // false when the file had to be decoded whole
+  bool streamed() const;
+
+  bool is_valid() const;
+
+ private:
+  MappedFile m_file;
+  Image m_image;  // whole decode of formats that can not be streamed
+  unsigned char* m_pixels;
+  std::size_t m_offset;  // of the pixels in the file
+  int m_width, m_height, m_channels, m_channels_in_file;
+  Image::Type m_type;
+};
+
+// box filters strips down by an integer factor as they arrive, only the output and one row of sums are kept,
+// edge blocks that are cut off by the image size average the pixels they cover
+class StripDownsampler
+{
+ public:
+  StripDownsampler(int width, int height, int channels, int factor);
+
+  // 8 bit strips with the channel count given above, top to bottom without gaps
+  void add(const ImageView& strip);
+
+  // complete once all source rows were added
+  const Image& result() const;
+  Image release();
+
+ private:
+  Image m_result;
+  std::vector<uint32_t> m_sums;
+  int m_width, m_height, m_factor;
+  int m_rows;  // source rows added so far
+};
+
+namespace detail
+{
+// parses the header of a binary 8 bit ppm (rgb) or pgm (grey), returns the offset of the pixel data or 0
+std::size_t parse_pnm_header(const unsigned char* data, std::size_t size, int* width, int* height, int* channels);
+}  // namespace detail
+}  // namespace gfx
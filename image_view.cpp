@@ -0,0 +1,208 @@
+#include "image_view.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "image_convert.h"
+#include "image_rows.h"
+#include "stb/stb_image_write.h"
+
+namespace gfx
+{
+
+ImageView::ImageView() noexcept
+    : m_data(nullptr), m_width(0), m_height(0), m_channels(0), m_stride(0), m_type(Image::UNSIGNED_BYTE)
+{
+}
+
+ImageView::ImageView(unsigned char* data, int width, int height, int channels, std::size_t stride,
+                     Image::Type type) noexcept
+    : m_data(data), m_width(width), m_height(height), m_channels(channels), m_stride(stride), m_type(type)
+{
+  if (m_stride == 0) {
+    m_stride = static_cast<std::size_t>(width) * bytes_per_pixel();
+  }
+}
+
+ImageView::ImageView(const Image& image) noexcept
+    : ImageView(image.data(), image.width(), image.height(), image.channels(), 0, image.type())
+{
+}
+
+ImageView::ImageView(const Image& image, int x, int y, int width, int height) noexcept
+    : ImageView(ImageView(image).sub(x, y, width, height))
+{
+}
+
+ImageView ImageView::sub(int x, int y, int width, int height) const
+{
+  int x0 = std::clamp(x, 0, m_width), y0 = std::clamp(y, 0, m_height);
+  int x1 = std::clamp(x + width, x0, m_width), y1 = std::clamp(y + height, y0, m_height);
+
+  if (!is_valid() || x0 == x1 || y0 == y1) {
+    return ImageView();
+  }
+
+  return ImageView(row(y0) + static_cast<std::size_t>(x0) * bytes_per_pixel(), x1 - x0, y1 - y0, m_channels, m_stride,
+                   m_type);
+}
+
+unsigned char* ImageView::data() const { return m_data; }
+
+unsigned char* ImageView::row(int y) const { return m_data + y * m_stride; }
+
+int ImageView::width() const { return m_width; }
+
+int ImageView::height() const { return m_height; }
+
+int ImageView::channels() const { return m_channels; }
+
+std::size_t ImageView::stride() const { return m_stride; }
+
+Image::Type ImageView::type() const { return m_type; }
+
+int ImageView::bytes_per_pixel() const { return m_channels * detail::type_size(m_type); }
+
+bool ImageView::is_valid() const { return (m_data != nullptr) && (0 < m_width) && (0 < m_height) && (0 < m_channels); }
+
+Image::Format ImageView::format() const
+{
+  assert(1 <= m_channels && m_channels <= 4);
+  static Image::Format formats[] = {Image::RED, Image::RG, Image::RGB, Image::RGBA};
+  return formats[m_channels - 1];
+}
+
+bool ImageView::write_png(const std::filesystem::path& path) const
+{
+  if (!is_valid() || m_type != Image::UNSIGNED_BYTE) {
+    return false;
+  }
+  return stbi_write_png(path.string().c_str(), m_width, m_height, m_channels, m_data, static_cast<int>(m_stride)) ==
+         1;
+}
+
+bool ImageView::write_hdr(const std::filesystem::path& path) const
+{
+  if (!is_valid() || (m_type != Image::FLOAT && m_type != Image::HALF_FLOAT) || m_channels > 4) {
+    return false;
+  }
+
+  const std::size_t values = static_cast<std::size_t>(m_width) * m_channels;
+  if (m_type == Image::FLOAT && m_stride == values * sizeof(float)) {
+    return stbi_write_hdr(path.string().c_str(), m_width, m_height, m_channels, reinterpret_cast<float*>(m_data)) ==
+           1;
+  }
+
+  // stb wants packed float rows
+  std::vector<float> pixels(values * m_height);
+  for (int y = 0; y < m_height; y++) {
+    if (m_type == Image::HALF_FLOAT) {
+      half_to_float(reinterpret_cast<const uint16_t*>(row(y)), pixels.data() + y * values, values);
+    } else {
+      std::memcpy(pixels.data() + y * values, row(y), values * sizeof(float));
+    }
+  }
+  return stbi_write_hdr(path.string().c_str(), m_width, m_height, m_channels, pixels.data()) == 1;
+}
+
+void ImageView::set_pixel(int x, int y, const unsigned char* pixel) const
+{
+  if (is_valid() && (0 <= x && x < m_width) && (0 <= y && y < m_height)) {
+    std::memcpy(row(y) + x * bytes_per_pixel(), pixel, bytes_per_pixel());
+  }
+}
+
+glm::u8vec4 ImageView::pixel(int x, int y) const
+{
+  glm::u8vec4 pixel(0);
+
+  if (is_valid() && (0 <= x && x < m_width) && (0 <= y && y < m_height)) {
+    const unsigned char* p = row(y) + x * bytes_per_pixel();
+    for (int c = 0; c < glm::min(m_channels, 4); c++) {
+      switch (m_type) {
+        case Image::UNSIGNED_SHORT: {
+          uint16_t value;
+          std::memcpy(&value, p + c * sizeof(value), sizeof(value));
+          pixel[c] = static_cast<unsigned char>(value >> 8);
+          break;
+        }
+        case Image::HALF_FLOAT: {
+          uint16_t value;
+          std::memcpy(&value, p + c * sizeof(value), sizeof(value));
+          pixel[c] = static_cast<unsigned char>(std::clamp(half_to_float(value), 0.0f, 1.0f) * 255.0f + 0.5f);
+          break;
+        }
+        case Image::FLOAT: {
+          float value;
+          std::memcpy(&value, p + c * sizeof(value), sizeof(value));
+          pixel[c] = static_cast<unsigned char>(std::clamp(value, 0.0f, 1.0f) * 255.0f + 0.5f);
+          break;
+        }
+        default:
+          pixel[c] = p[c];
+          break;
+      }
+    }
+  }
+
+  return pixel;
+}
+
+glm::u8vec4 ImageView::sample(const glm::vec2& uv, Image::Sampling algorithm) const
+{
+  if (!is_valid() || !(0.f <= uv.x && uv.x <= 1.0f) || !(0.f <= uv.y && uv.y <= 1.0f)) {
+    return glm::u8vec4(0);
+  }
+
+  switch (algorithm) {
+    // nearest neighbour
+    case gfx::Image::NEAREST: {
+      int x = static_cast<int>(uv.x * (m_width - 1));
+      int y = static_cast<int>(uv.y * (m_height - 1));
+      return pixel(x, y);
+    }
+    // bilinear interpolation, the neighbours are clamped to the edge
+    case gfx::Image::LINEAR: {
+      float x = uv.x * (m_width - 1);
+      float y = uv.y * (m_height - 1);
+
+      int x0 = static_cast<int>(x);
+      int y0 = static_cast<int>(y);
+      int x1 = glm::min(x0 + 1, m_width - 1);
+      int y1 = glm::min(y0 + 1, m_height - 1);
+      float x_frac = x - x0;
+      float y_frac = y - y0;
+
+      glm::vec4 t = glm::mix(glm::vec4(pixel(x0, y0)), glm::vec4(pixel(x1, y0)), x_frac);
+      glm::vec4 b = glm::mix(glm::vec4(pixel(x0, y1)), glm::vec4(pixel(x1, y1)), x_frac);
+
+      return glm::u8vec4(glm::mix(t, b, y_frac) + 0.5f);
+    }
+    default:
+      assert(false);
+      return glm::u8vec4();
+  }
+}
+
+Image ImageView::copy() const
+{
+  if (!is_valid()) {
+    return Image();
+  }
+
+  Image image(m_width, m_height, m_channels, m_type);
+  if (!image.is_valid()) {
+    return image;
+  }
+
+  const std::size_t row_size = static_cast<std::size_t>(m_width) * bytes_per_pixel();
+  for (int y = 0; y < m_height; y++) {
+    std::memcpy(image.data() + y * row_size, row(y), row_size);
+  }
+  return image;
+}
+
+}  // namespace gfx
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+#include <glm/glm.hpp>
+
+#include "image.h"
+
+namespace gfx
+{
+// non owning window into pixels of an Image or external memory, rows are stride bytes apart
+class ImageView
+{
+ public:
+  ImageView() noexcept;
+  // stride 0 means tightly packed rows
+  ImageView(unsigned char* data, int width, int height, int channels, std::size_t stride = 0,
+            Image::Type type = Image::UNSIGNED_BYTE) noexcept;
+  explicit ImageView(const Image& image) noexcept;
+  ImageView(const Image& image, int x, int y, int width, int height) noexcept;
+
+  // region relative to this view, clipped to its bounds
+  ImageView sub(int x, int y, int width, int height) const;
+
+  unsigned char* data() const;
+  unsigned char* row(int y) const;
+  int width() const;
+  int height() const;
+  int channels() const;
+  std::size_t stride() const;
+  Image::Type type() const;
+  int bytes_per_pixel() const;
+
+  Image::Format format() const;
+
+  // png output is 8 bit only
+  bool write_png(const std::filesystem::path& path) const;
+  // radiance .hdr output of float and half float pixels
+  bool write_hdr(const std::filesystem::path& path) const;
+
+  // 16 bit, half float and float pixels are converted to 8 bit
+  glm::u8vec4 pixel(int x, int y) const;
+  glm::u8vec4 sample(const glm::vec2&, Image::Sampling algorithm = Image::NEAREST) const;
+
+  // writes bytes_per_pixel() bytes to the viewed memory
+  void set_pixel(int x, int y, const unsigned char* pixel) const;
+
+  // packed copy of the viewed pixels
+  Image copy() const;
+
+  bool is_valid() const;
+
+ private:
+  unsigned char* m_data;
+  int m_width, m_height, m_channels;
+  std::size_t m_stride;
+  Image::Type m_type;
+};
+}  // namespace gfx
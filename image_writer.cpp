@@ -0,0 +1,410 @@
+#include "image_writer.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+
+#include "stb/stb_image_write.h"
+#include "thread_pool.h"
+
+// defined by stb_image_write but not declared in its header, the result is released with free()
+STBIWDEF unsigned char* stbi_zlib_compress(unsigned char* data, int data_len, int* out_len, int quality);
+
+namespace gfx
+{
+
+namespace
+{
+
+uint32_t crc32(const unsigned char* data, std::size_t len, uint32_t crc = 0)
+{
+  static const auto table = [] {
+    std::vector<uint32_t> t(256);
+    for (uint32_t i = 0; i < 256; i++) {
+      uint32_t c = i;
+      for (int k = 0; k < 8; k++) {
+        c = (c & 1) ? 0xedb88320U ^ (c >> 1) : c >> 1;
+      }
+      t[i] = c;
+    }
+    return t;
+  }();
+
+  crc = ~crc;
+  for (std::size_t i = 0; i < len; i++) {
+    crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+  }
+  return ~crc;
+}
+
+uint32_t adler32(const unsigned char* data, std::size_t len)
+{
+  uint32_t a = 1, b = 0;
+  while (len > 0) {
+    // largest block before b can overflow
+    std::size_t block = std::min<std::size_t>(len, 5552);
+    for (std::size_t i = 0; i < block; i++) {
+      a += data[i];
+      b += a;
+    }
+    a %= 65521;
+    b %= 65521;
+    data += block;
+    len -= block;
+  }
+  return (b << 16) | a;
+}
+
+void put_u32(std::vector<unsigned char>& out, uint32_t v)
+{
+  out.push_back(static_cast<unsigned char>(v >> 24));
+  out.push_back(static_cast<unsigned char>(v >> 16));
+  out.push_back(static_cast<unsigned char>(v >> 8));
+  out.push_back(static_cast<unsigned char>(v));
+}
+
+// deflate streams are written least significant bit first
+struct BitWriter {
+  std::vector<unsigned char>& out;
+  uint32_t buffer = 0;
+  int count = 0;
+
+  void put(uint32_t bits, int n)
+  {
+    buffer |= bits << count;
+    count += n;
+    while (count >= 8) {
+      out.push_back(static_cast<unsigned char>(buffer));
+      buffer >>= 8;
+      count -= 8;
+    }
+  }
+
+  // huffman codes are stored most significant bit first
+  void put_code(uint32_t code, int n)
+  {
+    uint32_t reversed = 0;
+    for (int i = 0; i < n; i++) {
+      reversed = (reversed << 1) | ((code >> i) & 1);
+    }
+    put(reversed, n);
+  }
+
+  void flush()
+  {
+    if (count > 0) {
+      out.push_back(static_cast<unsigned char>(buffer));
+    }
+    buffer = 0;
+    count = 0;
+  }
+};
+
+void put_literal(BitWriter& bits, int symbol)
+{
+  if (symbol <= 143) {
+    bits.put_code(0x30 + symbol, 8);
+  } else if (symbol <= 255) {
+    bits.put_code(0x190 + symbol - 144, 9);
+  } else if (symbol <= 279) {
+    bits.put_code(symbol - 256, 7);
+  } else {
+    bits.put_code(0xc0 + symbol - 280, 8);
+  }
+}
+
+void deflate_store(const unsigned char* data, std::size_t len, std::vector<unsigned char>& out)
+{
+  std::size_t offset = 0;
+  do {
+    std::size_t block = std::min<std::size_t>(len - offset, 65535);
+    bool last = offset + block == len;
+    out.push_back(last ? 1 : 0);
+    out.push_back(static_cast<unsigned char>(block));
+    out.push_back(static_cast<unsigned char>(block >> 8));
+    out.push_back(static_cast<unsigned char>(~block));
+    out.push_back(static_cast<unsigned char>(~block >> 8));
+    out.insert(out.end(), data + offset, data + offset + block);
+    offset += block;
+  } while (offset < len);
+}
+
+// zlib's Z_RLE strategy, only distance 1 matches
+void deflate_rle(const unsigned char* data, std::size_t len, std::vector<unsigned char>& out)
+{
+  static const unsigned short length_base[] = {3,  4,  5,  6,  7,  8,  9,  10, 11,  13,  15,  17,  19,  23, 27,
+                                               31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+  static const unsigned char length_extra[] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2,
+                                               2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+
+  BitWriter bits{out};
+  bits.put(1, 1);  // final block
+  bits.put(1, 2);  // fixed huffman codes
+
+  std::size_t i = 0;
+  while (i < len) {
+    std::size_t run = 0;
+    if (i > 0) {
+      while (run < 258 && i + run < len && data[i + run] == data[i - 1]) {
+        run++;
+      }
+    }
+
+    if (run < 3) {
+      put_literal(bits, data[i]);
+      i++;
+      continue;
+    }
+
+    int code = 0;
+    while (code + 1 < 29 && length_base[code + 1] <= run) {
+      code++;
+    }
+    put_literal(bits, 257 + code);
+    bits.put(static_cast<uint32_t>(run - length_base[code]), length_extra[code]);
+    bits.put_code(0, 5);  // distance 1
+    i += run;
+  }
+
+  put_literal(bits, 256);
+  bits.flush();
+}
+
+bool zlib_compress(const std::vector<unsigned char>& data, const PngOptions& options, std::vector<unsigned char>& out)
+{
+  out.push_back(0x78);
+  out.push_back(0x01);
+
+  switch (options.compression) {
+    case PngOptions::STORE:
+      deflate_store(data.data(), data.size(), out);
+      put_u32(out, adler32(data.data(), data.size()));
+      return true;
+    case PngOptions::RLE:
+      deflate_rle(data.data(), data.size(), out);
+      put_u32(out, adler32(data.data(), data.size()));
+      return true;
+    default: {
+      // stbi_zlib_compress writes its own zlib header and checksum
+      out.clear();
+      int len = 0;
+      // stb's quality is the length of its hash chains and anything under 5 is raised to 5, so the levels are spread
+      // over what it honours. level 4 is stb's own default
+      static const int qualities[] = {5, 6, 7, 8, 10, 12, 16, 24, 32};
+      int quality = qualities[std::clamp(options.level, 1, 9) - 1];
+      unsigned char* zlib =
+          stbi_zlib_compress(const_cast<unsigned char*>(data.data()), static_cast<int>(data.size()), &len, quality);
+      if (!zlib) {
+        return false;
+      }
+      out.assign(zlib, zlib + len);
+      std::free(zlib);
+      return true;
+    }
+  }
+}
+
+inline int paeth(int a, int b, int c)
+{
+  int p = a + b - c;
+  int pa = std::abs(p - a), pb = std::abs(p - b), pc = std::abs(p - c);
+  if (pa <= pb && pa <= pc) return a;
+  if (pb <= pc) return b;
+  return c;
+}
+
+void filter_row(int filter, const unsigned char* row, const unsigned char* prior, std::size_t len, int bpp,
+                unsigned char* out)
+{
+  for (std::size_t i = 0; i < len; i++) {
+    int a = i >= static_cast<std::size_t>(bpp) ? row[i - bpp] : 0;
+    int b = prior ? prior[i] : 0;
+    int c = (prior && i >= static_cast<std::size_t>(bpp)) ? prior[i - bpp] : 0;
+    int predicted = 0;
+    switch (filter) {
+      case PngOptions::SUB:
+        predicted = a;
+        break;
+      case PngOptions::UP:
+        predicted = b;
+        break;
+      case PngOptions::AVERAGE:
+        predicted = (a + b) >> 1;
+        break;
+      case PngOptions::PAETH:
+        predicted = paeth(a, b, c);
+        break;
+      default:
+        break;
+    }
+    out[i] = static_cast<unsigned char>(row[i] - predicted);
+  }
+}
+
+void put_chunk(std::vector<unsigned char>& png, const char* type, const unsigned char* data, std::size_t len)
+{
+  put_u32(png, static_cast<uint32_t>(len));
+  std::size_t start = png.size();
+  png.insert(png.end(), type, type + 4);
+  png.insert(png.end(), data, data + len);
+  put_u32(png, crc32(png.data() + start, len + 4));
+}
+
+}  // namespace
+
+bool encode_png(const ImageView& view, const PngOptions& options, std::vector<unsigned char>& png)
+{
+  if (!view.is_valid() || view.channels() > 4 ||
+      (view.type() != Image::UNSIGNED_BYTE && view.type() != Image::UNSIGNED_SHORT)) {
+    return false;
+  }
+
+  const int depth = view.type() == Image::UNSIGNED_SHORT ? 16 : 8;
+  const int bpp = view.bytes_per_pixel();
+  const std::size_t row_size = static_cast<std::size_t>(view.width()) * bpp;
+
+  // png stores 16 bit samples big endian
+  std::vector<unsigned char> current(row_size), previous(row_size);
+  std::vector<unsigned char> filtered(view.height() * (row_size + 1));
+  std::vector<unsigned char> candidate(row_size);
+
+  for (int y = 0; y < view.height(); y++) {
+    std::memcpy(current.data(), view.row(y), row_size);
+    if (depth == 16) {
+      for (std::size_t i = 0; i < row_size; i += 2) {
+        std::swap(current[i], current[i + 1]);
+      }
+    }
+
+    const unsigned char* prior = y > 0 ? previous.data() : nullptr;
+    unsigned char* out = filtered.data() + y * (row_size + 1);
+
+    int filter = options.filter;
+    if (filter == PngOptions::ADAPTIVE) {
+      // the filter with the smallest sum of absolute residuals, the usual heuristic
+      long best = -1;
+      for (int f = PngOptions::NONE; f <= PngOptions::PAETH; f++) {
+        filter_row(f, current.data(), prior, row_size, bpp, candidate.data());
+        long sum = 0;
+        for (unsigned char v : candidate) {
+          sum += std::abs(static_cast<signed char>(v));
+        }
+        if (best < 0 || sum < best) {
+          best = sum;
+          filter = f;
+        }
+      }
+    }
+
+    out[0] = static_cast<unsigned char>(filter);
+    filter_row(filter, current.data(), prior, row_size, bpp, out + 1);
+    std::swap(current, previous);
+  }
+
+  std::vector<unsigned char> zlib;
+  if (!zlib_compress(filtered, options, zlib)) {
+    return false;
+  }
+
+  static const unsigned char color_types[] = {0, 4, 2, 6};  // grey, grey alpha, rgb, rgba
+  static const unsigned char signature[] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+
+  std::vector<unsigned char> header;
+  put_u32(header, view.width());
+  put_u32(header, view.height());
+  header.push_back(static_cast<unsigned char>(depth));
+  header.push_back(color_types[view.channels() - 1]);
+  header.push_back(0);  // deflate
+  header.push_back(0);  // adaptive filtering
+  header.push_back(0);  // no interlace
+
+  png.assign(signature, signature + sizeof(signature));
+  put_chunk(png, "IHDR", header.data(), header.size());
+  put_chunk(png, "IDAT", zlib.data(), zlib.size());
+  put_chunk(png, "IEND", nullptr, 0);
+  return true;
+}
+
+bool write_png(const std::filesystem::path& path, const ImageView& view, const PngOptions& options)
+{
+  std::vector<unsigned char> png;
+  if (!encode_png(view, options, png)) {
+    return false;
+  }
+
+  std::ofstream file(path, std::ios::binary | std::ios::trunc);
+  file.write(reinterpret_cast<const char*>(png.data()), static_cast<std::streamsize>(png.size()));
+  return file.good();
+}
+
+ImageWriter::ImageWriter(unsigned num_threads, std::size_t max_pending, const PngOptions& options)
+    : m_pool(std::make_unique<ThreadPool>(num_threads)), m_max_pending(std::max<std::size_t>(max_pending, 1)),
+      m_options(options)
+{
+}
+
+ImageWriter::~ImageWriter()
+{
+  flush();
+  m_pool.reset();
+}
+
+void ImageWriter::write_png(const std::filesystem::path& path, Image image)
+{
+  {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_condition.wait(lock, [this] { return m_pending < m_max_pending; });
+    m_pending++;
+  }
+  enqueue(path, std::move(image));
+}
+
+bool ImageWriter::try_write_png(const std::filesystem::path& path, Image& image)
+{
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_pending >= m_max_pending) {
+      return false;
+    }
+    m_pending++;
+  }
+  enqueue(path, std::move(image));
+  return true;
+}
+
+void ImageWriter::enqueue(const std::filesystem::path& path, Image image)
+{
+  // std::function needs a copyable callable
+  auto shared = std::make_shared<Image>(std::move(image));
+
+  m_pool->submit([this, path, shared]() {
+    bool ok = gfx::write_png(path, ImageView(*shared), m_options);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_failed += ok ? 0 : 1;
+    m_pending--;
+    m_condition.notify_all();
+  });
+}
+
+void ImageWriter::flush()
+{
+  std::unique_lock<std::mutex> lock(m_mutex);
+  m_condition.wait(lock, [this] { return m_pending == 0; });
+}
+
+std::size_t ImageWriter::pending() const
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_pending;
+}
+
+std::size_t ImageWriter::failed() const
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_failed;
+}
+
+}  // namespace gfx
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "image.h"
+#include "image_view.h"
+
+namespace gfx
+{
+class ThreadPool;
+
+struct PngOptions {
+  enum Compression {
+    STORE,    // uncompressed deflate blocks, fastest
+    RLE,      // run length matches with fixed huffman codes, fast and good for flat renders
+    DEFLATE,  // full lz77 search at the given level
+  };
+
+  enum Filter { NONE, SUB, UP, AVERAGE, PAETH, ADAPTIVE };
+
+  Compression compression = DEFLATE;
+  int level = 4;  // 1 to 9, DEFLATE only, longer match searches and smaller files as it goes up
+  Filter filter = ADAPTIVE;
+};
+
+// thread safe png encoder for 8 and 16 bit images, unlike stbi_write_png it has no global settings
+bool encode_png(const ImageView& view, const PngOptions& options, std::vector<unsigned char>& png);
+bool write_png(const std::filesystem::path& path, const ImageView& view, const PngOptions& options);
+
+// encodes and writes pngs on background threads, e.g. to record frames at full frame rate
+class ImageWriter
+{
+ public:
+  explicit ImageWriter(unsigned num_threads = 2, std::size_t max_pending = 8, const PngOptions& options = {});
+  // finishes all pending writes
+  ~ImageWriter();
+
+  ImageWriter(const ImageWriter&) = delete;
+  ImageWriter& operator=(const ImageWriter&) = delete;
+
+  // blocks while max_pending images are waiting to be written
+  void write_png(const std::filesystem::path& path, Image image);
+  // returns false instead of blocking when the queue is full, image is left untouched in that case
+  bool try_write_png(const std::filesystem::path& path, Image& image);
+
+  // wait until all pending writes are done
+  void flush();
+
+  std::size_t pending() const;
+  std::size_t failed() const;  // writes that could not be encoded or saved so far
+
+ private:
+  std::unique_ptr<ThreadPool> m_pool;
+  std::size_t m_max_pending;
+  PngOptions m_options;
+
+  mutable std::mutex m_mutex;
+  std::condition_variable m_condition;
+  std::size_t m_pending = 0;
+  std::size_t m_failed = 0;
+
+  void enqueue(const std::filesystem::path& path, Image image);
+};
+}  // namespace gfx
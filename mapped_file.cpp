@@ -0,0 +1,147 @@
+#include "mapped_file.h"
+
+#include <algorithm>
+#include <utility>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace gfx
+{
+
+#ifdef _WIN32
+
+MappedFile::MappedFile() noexcept : m_data(nullptr), m_size(0), m_mapping(nullptr) {}
+
+MappedFile::MappedFile(const std::filesystem::path& path) noexcept : MappedFile()
+{
+  HANDLE file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                            FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+  if (file == INVALID_HANDLE_VALUE) {
+    return;
+  }
+
+  LARGE_INTEGER size;
+  if (GetFileSizeEx(file, &size) && size.QuadPart > 0) {
+    m_mapping = CreateFileMappingW(file, nullptr, PAGE_WRITECOPY, 0, 0, nullptr);
+    if (m_mapping) {
+      m_data = static_cast<unsigned char*>(MapViewOfFile(m_mapping, FILE_MAP_COPY, 0, 0, 0));
+      m_size = m_data ? static_cast<std::size_t>(size.QuadPart) : 0;
+    }
+  }
+
+  // the mapping keeps the file open
+  CloseHandle(file);
+}
+
+void MappedFile::cleanup()
+{
+  if (m_data) {
+    UnmapViewOfFile(m_data);
+  }
+  if (m_mapping) {
+    CloseHandle(m_mapping);
+  }
+  m_data = nullptr;
+  m_size = 0;
+  m_mapping = nullptr;
+}
+
+void MappedFile::swap(MappedFile& other)
+{
+  std::swap(m_data, other.m_data);
+  std::swap(m_size, other.m_size);
+  std::swap(m_mapping, other.m_mapping);
+}
+
+void MappedFile::release(std::size_t offset, std::size_t size) const
+{
+  // unlocking pages that are not locked removes them from the working set
+  if (m_data && offset < m_size) {
+    VirtualUnlock(m_data + offset, std::min(size, m_size - offset));
+  }
+}
+
+#else
+
+MappedFile::MappedFile() noexcept : m_data(nullptr), m_size(0) {}
+
+MappedFile::MappedFile(const std::filesystem::path& path) noexcept : MappedFile()
+{
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return;
+  }
+
+  struct stat info;
+  if (fstat(fd, &info) == 0 && info.st_size > 0) {
+    void* data = mmap(nullptr, info.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    if (data != MAP_FAILED) {
+      // images are decoded front to back
+      madvise(data, info.st_size, MADV_SEQUENTIAL);
+      madvise(data, info.st_size, MADV_WILLNEED);
+      m_data = static_cast<unsigned char*>(data);
+      m_size = static_cast<std::size_t>(info.st_size);
+    }
+  }
+
+  // the mapping keeps the file open
+  close(fd);
+}
+
+void MappedFile::cleanup()
+{
+  if (m_data) {
+    munmap(m_data, m_size);
+  }
+  m_data = nullptr;
+  m_size = 0;
+}
+
+void MappedFile::swap(MappedFile& other)
+{
+  std::swap(m_data, other.m_data);
+  std::swap(m_size, other.m_size);
+}
+
+void MappedFile::release(std::size_t offset, std::size_t size) const
+{
+  if (!m_data || offset >= m_size) {
+    return;
+  }
+
+  const std::size_t page = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+  const std::size_t begin = offset / page * page;
+  const std::size_t end = std::min(offset + size, m_size);
+  madvise(m_data + begin, end - begin, MADV_DONTNEED);
+}
+
+#endif
+
+MappedFile::MappedFile(MappedFile&& other) noexcept : MappedFile() { swap(other); }
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept
+{
+  if (this != &other) {
+    swap(other);
+  }
+  return *this;
+}
+
+MappedFile::~MappedFile() noexcept { cleanup(); }
+
+unsigned char* MappedFile::data() const { return m_data; }
+
+std::size_t MappedFile::size() const { return m_size; }
+
+bool MappedFile::is_valid() const { return m_data != nullptr; }
+
+}  // namespace gfx
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+
+namespace gfx
+{
+// read only view of a whole file, pages are copy on write so writes never reach the file
+class MappedFile
+{
+ public:
+  MappedFile() noexcept;
+  explicit MappedFile(const std::filesystem::path& path) noexcept;
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  MappedFile(MappedFile&&) noexcept;
+  MappedFile& operator=(MappedFile&&) noexcept;
+
+  ~MappedFile() noexcept;
+
+  unsigned char* data() const;
+  std::size_t size() const;
+
+  // drop the pages of a range that was read and is not needed anymore, they are read from the file again if touched,
+  // pages that were written lose their changes
+  void release(std::size_t offset, std::size_t size) const;
+
+  bool is_valid() const;
+
+ private:
+  unsigned char* m_data;
+  std::size_t m_size;
+#ifdef _WIN32
+  void* m_mapping;
+#endif
+
+  void cleanup();
+  void swap(MappedFile&);
+};
+}  // namespace gfx
@@ -0,0 +1,145 @@
+#include "mipmap.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+#include "image_convert.h"
+#include "image_rows.h"
+#include "simd.h"
+#include "thread_pool.h"
+
+namespace gfx
+{
+
+namespace
+{
+
+// sum of two source rows in linear space, one float per channel
+void linearize_rows(const unsigned char* a, const unsigned char* b, float* sum, float* scratch, int width, int channels,
+                    bool srgb)
+{
+  const std::size_t count = static_cast<std::size_t>(width) * channels;
+  if (srgb) {
+    srgb_to_linear(a, sum, channels, width);
+    srgb_to_linear(b, scratch, channels, width);
+  } else {
+    unorm8_to_float(a, sum, count);
+    unorm8_to_float(b, scratch, count);
+  }
+
+  for (std::size_t i = 0; i < count; i++) {
+    sum[i] += scratch[i];
+  }
+}
+
+// average horizontal pairs of the summed rows, the last column is repeated for odd widths
+void reduce_row(const float* sum, float* out, int src_width, int dst_width, int channels)
+{
+  int x = 0;
+#if defined(GFX_SSE2)
+  if (channels == 4) {
+    const __m128 quarter = _mm_set1_ps(0.25f);
+    for (; x < dst_width && 2 * x + 1 < src_width; x++) {
+      __m128 left = _mm_loadu_ps(sum + (2 * x) * 4);
+      __m128 right = _mm_loadu_ps(sum + (2 * x + 1) * 4);
+      _mm_storeu_ps(out + x * 4, _mm_mul_ps(_mm_add_ps(left, right), quarter));
+    }
+  }
+#endif
+  for (; x < dst_width; x++) {
+    int x0 = 2 * x;
+    int x1 = std::min(2 * x + 1, src_width - 1);
+    for (int c = 0; c < channels; c++) {
+      out[x * channels + c] = (sum[x0 * channels + c] + sum[x1 * channels + c]) * 0.25f;
+    }
+  }
+}
+
+void downsample(const unsigned char* src, int src_width, int src_height, unsigned char* dst, int dst_width,
+                int dst_height, int channels, bool srgb)
+{
+  const std::size_t src_stride = static_cast<std::size_t>(src_width) * channels;
+  const std::size_t dst_stride = static_cast<std::size_t>(dst_width) * channels;
+
+  // two source rows per output row
+  ThreadPool::global().parallel_for(
+      0, dst_height,
+      [&](int row_begin, int row_end) {
+        std::vector<float> sum(src_stride), scratch(src_stride);
+        std::vector<float> row(dst_stride);
+
+        for (int y = row_begin; y < row_end; y++) {
+          const unsigned char* a = src + (2 * y) * src_stride;
+          const unsigned char* b = src + std::min(2 * y + 1, src_height - 1) * src_stride;
+          linearize_rows(a, b, sum.data(), scratch.data(), src_width, channels, srgb);
+          reduce_row(sum.data(), row.data(), src_width, dst_width, channels);
+          if (srgb) {
+            linear_to_srgb(row.data(), dst + y * dst_stride, channels, dst_width);
+          } else {
+            float_to_unorm8(row.data(), dst + y * dst_stride, dst_stride);
+          }
+        }
+      },
+      detail::row_grain(src_stride * 2));
+}
+
+}  // namespace
+
+MipChain::MipChain() noexcept : m_channels(0) {}
+
+MipChain::MipChain(const Image& image, bool srgb) : MipChain()
+{
+  // the box filter works on 8 bit channels
+  if (!image.is_valid() || image.channels() > 4 || image.type() != Image::UNSIGNED_BYTE) {
+    return;
+  }
+
+  m_channels = image.channels();
+
+  std::size_t total = 0;
+  int width = image.width(), height = image.height();
+  while (true) {
+    std::size_t size = static_cast<std::size_t>(width) * height * m_channels;
+    m_levels.push_back({width, height, total, size});
+    total += size;
+    if (width == 1 && height == 1) break;
+    width = std::max(width / 2, 1);
+    height = std::max(height / 2, 1);
+  }
+
+  m_data.resize(total);
+  std::memcpy(m_data.data(), image.data(), m_levels[0].size);
+
+  for (std::size_t i = 1; i < m_levels.size(); i++) {
+    const Level& src = m_levels[i - 1];
+    const Level& dst = m_levels[i];
+    downsample(m_data.data() + src.offset, src.width, src.height, m_data.data() + dst.offset, dst.width, dst.height,
+               m_channels, srgb);
+  }
+}
+
+int MipChain::levels() const { return static_cast<int>(m_levels.size()); }
+
+int MipChain::channels() const { return m_channels; }
+
+int MipChain::width(int level) const { return m_levels[level].width; }
+
+int MipChain::height(int level) const { return m_levels[level].height; }
+
+Image::Format MipChain::format() const
+{
+  assert(1 <= m_channels && m_channels <= 4);
+  static Image::Format formats[] = {Image::RED, Image::RG, Image::RGB, Image::RGBA};
+  return formats[m_channels - 1];
+}
+
+const MipChain::Level& MipChain::level(int level) const { return m_levels[level]; }
+
+const unsigned char* MipChain::data(int level) const { return m_data.data() + m_levels[level].offset; }
+
+std::size_t MipChain::size_bytes() const { return m_data.size(); }
+
+bool MipChain::is_valid() const { return !m_levels.empty(); }
+
+}  // namespace gfx
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "image.h"
+
+namespace gfx
+{
+// a full mip pyramid down to 1x1, all levels live in one contiguous allocation
+class MipChain
+{
+ public:
+  struct Level {
+    int width, height;
+    std::size_t offset, size;  // in bytes, relative to the start of the chain
+  };
+
+  MipChain() noexcept;
+  // downsample an 8 bit image with a 2x2 box filter, with srgb the color channels are averaged in linear space
+  explicit MipChain(const Image& image, bool srgb = true);
+
+  int levels() const;
+  int channels() const;
+  int width(int level = 0) const;
+  int height(int level = 0) const;
+
+  Image::Format format() const;
+
+  const Level& level(int level) const;
+  const unsigned char* data(int level = 0) const;
+  std::size_t size_bytes() const;
+
+  bool is_valid() const;
+
+ private:
+  std::vector<unsigned char> m_data;
+  std::vector<Level> m_levels;
+  int m_channels;
+};
+}  // namespace gfx
@@ -0,0 +1,370 @@
+#include "sampler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#include "image_rows.h"
+#include "simd.h"
+
+namespace gfx
+{
+
+namespace
+{
+
+using detail::max_ps;
+using detail::min_ps;
+
+static_assert(sizeof(glm::vec2) == 2 * sizeof(float), "sample_batch expects tightly packed uvs");
+
+// beyond this a float has no fractional part left to wrap, and u * width still fits an int
+constexpr float MAX_UV = 65536.0f;
+
+inline int floor_to_int(float v)
+{
+  int i = static_cast<int>(v);
+  return i - (static_cast<float>(i) > v ? 1 : 0);
+}
+
+inline float clamp_uv(float v) { return min_ps(max_ps(v, -MAX_UV), MAX_UV); }
+
+// log2 from the exponent bits and a polynomial for the mantissa, within 1e-4 of the exact value, which is plenty for
+// picking levels. the batch path runs the same operations four at a time so both select the same levels
+inline float fast_log2(float v)
+{
+  int32_t bits;
+  std::memcpy(&bits, &v, sizeof(bits));
+  float exponent = static_cast<float>((bits >> 23) - 127);
+  bits = (bits & 0x007fffff) | 0x3f800000;
+  float m;
+  std::memcpy(&m, &bits, sizeof(m));
+  return exponent + (-2.5056145f + (4.0496165f + (-2.0994018f + (0.63551092f - 0.080010844f * m) * m) * m) * m);
+}
+
+inline int wrap_index(int i, int n, Sampler::Wrap wrap)
+{
+  if (0 <= i && i < n) {
+    return i;
+  }
+
+  switch (wrap) {
+    case Sampler::REPEAT:
+      return ((i % n) + n) % n;
+    case Sampler::MIRROR: {
+      int m = ((i % (2 * n)) + 2 * n) % (2 * n);
+      return m < n ? m : 2 * n - 1 - m;
+    }
+    default:
+      return std::clamp(i, 0, n - 1);
+  }
+}
+
+inline uint32_t fetch_texel(const unsigned char* texel, int channels)
+{
+  unsigned char rgba[4] = {0, 0, 0, 0};
+  std::memcpy(rgba, texel, channels);
+  uint32_t value;
+  std::memcpy(&value, rgba, sizeof(value));
+  return value;
+}
+
+// one texel per register with the channels in the lanes, values stay in 8 bit steps
+#if defined(GFX_SSE2)
+
+using Color = __m128;
+
+inline Color load_color(const unsigned char* texel, int channels)
+{
+  const __m128i zero = _mm_setzero_si128();
+  __m128i v = _mm_cvtsi32_si128(static_cast<int>(fetch_texel(texel, channels)));
+  return _mm_cvtepi32_ps(_mm_unpacklo_epi16(_mm_unpacklo_epi8(v, zero), zero));
+}
+
+inline Color zero_color() { return _mm_setzero_ps(); }
+
+inline Color lerp(Color a, Color b, float t) { return _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(b, a), _mm_set1_ps(t))); }
+
+inline Color add(Color a, Color b) { return _mm_add_ps(a, b); }
+
+inline Color scale(Color a, float w) { return _mm_mul_ps(a, _mm_set1_ps(w)); }
+
+// filtered values are weighted means of texels, so they never leave [0, 255]
+inline glm::u8vec4 to_pixel(Color c)
+{
+  __m128i i = _mm_cvttps_epi32(_mm_add_ps(c, _mm_set1_ps(0.5f)));
+  i = _mm_packs_epi32(i, i);
+  uint32_t value = static_cast<uint32_t>(_mm_cvtsi128_si32(_mm_packus_epi16(i, i)));
+  glm::u8vec4 pixel;
+  std::memcpy(static_cast<void*>(&pixel), &value, sizeof(value));
+  return pixel;
+}
+
+#else
+
+using Color = glm::vec4;
+
+inline Color load_color(const unsigned char* texel, int channels)
+{
+  Color c(0.0f);
+  for (int i = 0; i < channels; i++) {
+    c[i] = texel[i];
+  }
+  return c;
+}
+
+inline Color zero_color() { return Color(0.0f); }
+
+inline Color lerp(Color a, Color b, float t) { return a + (b - a) * t; }
+
+inline Color add(Color a, Color b) { return a + b; }
+
+inline Color scale(Color a, float w) { return a * w; }
+
+inline glm::u8vec4 to_pixel(Color c) { return glm::u8vec4(c + 0.5f); }
+
+#endif
+
+// lookups within one level
+struct LevelSampler {
+  const unsigned char* data;
+  int width, height, channels;
+  Sampler::Wrap wrap_s, wrap_t;
+
+  inline Color texel(int x, int y) const
+  {
+    return load_color(data + (static_cast<std::size_t>(y) * width + x) * channels, channels);
+  }
+
+  Color nearest(glm::vec2 uv) const
+  {
+    int x = wrap_index(floor_to_int(clamp_uv(uv.x) * width), width, wrap_s);
+    int y = wrap_index(floor_to_int(clamp_uv(uv.y) * height), height, wrap_t);
+    return texel(x, y);
+  }
+
+  Color bilinear(glm::vec2 uv) const
+  {
+    float x = clamp_uv(uv.x) * width - 0.5f;
+    float y = clamp_uv(uv.y) * height - 0.5f;
+
+    int x0 = floor_to_int(x), y0 = floor_to_int(y);
+    float fx = x - x0, fy = y - y0;
+
+    int xa = wrap_index(x0, width, wrap_s), xb = wrap_index(x0 + 1, width, wrap_s);
+    int ya = wrap_index(y0, height, wrap_t), yb = wrap_index(y0 + 1, height, wrap_t);
+
+    Color t = lerp(texel(xa, ya), texel(xb, ya), fx);
+    Color b = lerp(texel(xa, yb), texel(xb, yb), fx);
+    return lerp(t, b, fy);
+  }
+};
+
+#if defined(GFX_SSE2)
+
+inline __m128 fast_log2(__m128 v)
+{
+  __m128i bits = _mm_castps_si128(v);
+  __m128 exponent = _mm_cvtepi32_ps(_mm_sub_epi32(_mm_srai_epi32(bits, 23), _mm_set1_epi32(127)));
+  __m128 m = _mm_castsi128_ps(
+      _mm_or_si128(_mm_and_si128(bits, _mm_set1_epi32(0x007fffff)), _mm_set1_epi32(0x3f800000)));
+
+  __m128 p = _mm_sub_ps(_mm_set1_ps(0.63551092f), _mm_mul_ps(_mm_set1_ps(0.080010844f), m));
+  p = _mm_add_ps(_mm_set1_ps(-2.0994018f), _mm_mul_ps(p, m));
+  p = _mm_add_ps(_mm_set1_ps(4.0496165f), _mm_mul_ps(p, m));
+  p = _mm_add_ps(_mm_set1_ps(-2.5056145f), _mm_mul_ps(p, m));
+  return _mm_add_ps(exponent, p);
+}
+
+// four interleaved vec2 as separate x and y registers
+inline void load_vec2(const glm::vec2* v, __m128& x, __m128& y)
+{
+  __m128 a = _mm_loadu_ps(&v[0].x);
+  __m128 b = _mm_loadu_ps(&v[2].x);
+  x = _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+  y = _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+}
+
+#endif
+
+}  // namespace
+
+Sampler::Sampler() noexcept : m_mips(nullptr), m_width(0.0f), m_height(0.0f) {}
+
+Sampler::Sampler(const MipChain& mips) : Sampler(mips, Params()) {}
+
+Sampler::Sampler(const MipChain& mips, const Params& params) : Sampler()
+{
+  if (!mips.is_valid()) {
+    return;
+  }
+
+  m_mips = &mips;
+  m_params = params;
+  m_params.max_anisotropy = std::max(1, m_params.max_anisotropy);
+
+  for (int i = 0; i < mips.levels(); i++) {
+    m_levels.push_back({mips.data(i), mips.width(i), mips.height(i)});
+  }
+  m_width = static_cast<float>(mips.width());
+  m_height = static_cast<float>(mips.height());
+}
+
+glm::u8vec4 Sampler::sample(const glm::vec2& uv, const glm::vec2& dx, const glm::vec2& dy) const
+{
+  if (!is_valid()) {
+    return glm::u8vec4(0);
+  }
+  return filter(uv, footprint(dx, dy));
+}
+
+glm::u8vec4 Sampler::sample_lod(const glm::vec2& uv, float lod) const
+{
+  if (!is_valid()) {
+    return glm::u8vec4(0);
+  }
+  const float max_lod = static_cast<float>(m_levels.size() - 1);
+  return filter(uv, {min_ps(max_ps(lod, 0.0f), max_lod), 1, glm::vec2(0.0f)});
+}
+
+float Sampler::lod(const glm::vec2& dx, const glm::vec2& dy) const
+{
+  return is_valid() ? footprint(dx, dy).lod : 0.0f;
+}
+
+// the footprint of a pixel is the parallelogram spanned by the derivatives in texels, its longer side picks the level.
+// anisotropic filtering instead covers the longer side with several taps and picks the level from the shorter one
+Sampler::Footprint Sampler::footprint(const glm::vec2& dx, const glm::vec2& dy) const
+{
+  const float max_lod = static_cast<float>(m_levels.size() - 1);
+
+  const float px = dx.x * m_width * (dx.x * m_width) + dx.y * m_height * (dx.y * m_height);
+  const float py = dy.x * m_width * (dy.x * m_width) + dy.y * m_height * (dy.y * m_height);
+  const float major = max_ps(px, py);
+
+  Footprint result{0.0f, 1, glm::vec2(0.0f)};
+  float size = major;
+
+  if (m_params.filter == ANISOTROPIC) {
+    const float minor = min_ps(px, py);
+    const float anisotropy = static_cast<float>(m_params.max_anisotropy);
+    // ratio of the squared lengths, a degenerate footprint takes as many taps as allowed
+    const float ratio = minor > 0.0f ? std::sqrt(major / minor) : anisotropy;
+    result.taps = static_cast<int>(std::ceil(min_ps(max_ps(ratio, 1.0f), anisotropy)));
+    size = major / static_cast<float>(result.taps * result.taps);
+    result.step = (px >= py ? dx : dy) / static_cast<float>(result.taps);
+  }
+
+  // half the log2 of the squared length
+  result.lod = min_ps(max_ps(0.5f * fast_log2(size) + m_params.lod_bias, 0.0f), max_lod);
+  return result;
+}
+
+glm::u8vec4 Sampler::filter(const glm::vec2& uv, const Footprint& footprint) const
+{
+  auto level = [&](int i) {
+    const Level& l = m_levels[i];
+    return LevelSampler{l.data, l.width, l.height, m_mips->channels(), m_params.wrap_s, m_params.wrap_t};
+  };
+
+  const int last = static_cast<int>(m_levels.size()) - 1;
+
+  auto trilinear = [&](const glm::vec2& p) {
+    int l0 = static_cast<int>(footprint.lod);
+    float t = footprint.lod - static_cast<float>(l0);
+    Color c = level(l0).bilinear(p);
+    if (t > 0.0f && l0 < last) {
+      c = lerp(c, level(l0 + 1).bilinear(p), t);
+    }
+    return c;
+  };
+
+  switch (m_params.filter) {
+    case NEAREST:
+      return to_pixel(level(static_cast<int>(footprint.lod + 0.5f)).nearest(uv));
+    case LINEAR:
+      return to_pixel(level(static_cast<int>(footprint.lod + 0.5f)).bilinear(uv));
+    case ANISOTROPIC: {
+      if (footprint.taps > 1) {
+        // taps are spread evenly over the longer side, centered on the uv
+        Color sum = zero_color();
+        const float center = 0.5f * static_cast<float>(footprint.taps - 1);
+        for (int i = 0; i < footprint.taps; i++) {
+          sum = add(sum, trilinear(uv + footprint.step * (static_cast<float>(i) - center)));
+        }
+        return to_pixel(scale(sum, 1.0f / static_cast<float>(footprint.taps)));
+      }
+      return to_pixel(trilinear(uv));
+    }
+    default:
+      return to_pixel(trilinear(uv));
+  }
+}
+
+void Sampler::sample_batch(const glm::vec2* uvs, const glm::vec2* dx, const glm::vec2* dy, glm::u8vec4* out,
+                           std::size_t count) const
+{
+  if (!is_valid()) {
+    std::fill(out, out + count, glm::u8vec4(0));
+    return;
+  }
+
+  std::size_t i = 0;
+
+#if defined(GFX_SSE2)
+  const __m128 width = _mm_set1_ps(m_width), height = _mm_set1_ps(m_height);
+  const __m128 zero = _mm_setzero_ps(), half = _mm_set1_ps(0.5f);
+  const __m128 bias = _mm_set1_ps(m_params.lod_bias);
+  const __m128 max_lod = _mm_set1_ps(static_cast<float>(m_levels.size() - 1));
+
+  // the anisotropic tap count needs a per lane divide and ceil, those lanes take the scalar route
+  if (m_params.filter != ANISOTROPIC) {
+    for (; i + 4 <= count; i += 4) {
+      __m128 dxu, dxv, dyu, dyv;
+      load_vec2(dx + i, dxu, dxv);
+      load_vec2(dy + i, dyu, dyv);
+
+      dxu = _mm_mul_ps(dxu, width);
+      dxv = _mm_mul_ps(dxv, height);
+      dyu = _mm_mul_ps(dyu, width);
+      dyv = _mm_mul_ps(dyv, height);
+
+      __m128 px = _mm_add_ps(_mm_mul_ps(dxu, dxu), _mm_mul_ps(dxv, dxv));
+      __m128 py = _mm_add_ps(_mm_mul_ps(dyu, dyu), _mm_mul_ps(dyv, dyv));
+      __m128 lod = _mm_add_ps(_mm_mul_ps(half, fast_log2(_mm_max_ps(px, py))), bias);
+      lod = _mm_min_ps(_mm_max_ps(lod, zero), max_lod);
+
+      alignas(16) float lods[4];
+      _mm_store_ps(lods, lod);
+      for (int j = 0; j < 4; j++) {
+        out[i + j] = filter(uvs[i + j], {lods[j], 1, glm::vec2(0.0f)});
+      }
+    }
+  }
+#endif
+
+  for (; i < count; i++) {
+    out[i] = filter(uvs[i], footprint(dx[i], dy[i]));
+  }
+}
+
+void Sampler::sample_batch(const glm::vec2* uvs, const glm::vec2& dx, const glm::vec2& dy, glm::u8vec4* out,
+                           std::size_t count) const
+{
+  if (!is_valid()) {
+    std::fill(out, out + count, glm::u8vec4(0));
+    return;
+  }
+
+  const Footprint shared = footprint(dx, dy);
+  for (std::size_t i = 0; i < count; i++) {
+    out[i] = filter(uvs[i], shared);
+  }
+}
+
+const Sampler::Params& Sampler::params() const { return m_params; }
+
+bool Sampler::is_valid() const { return m_mips != nullptr && !m_levels.empty(); }
+
+}  // namespace gfx
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstddef>
+#include <glm/glm.hpp>
+#include <vector>
+
+#include "mipmap.h"
+
+namespace gfx
+{
+// software texture lookups over a MipChain, following the GL rules: texel centers sit at (i + 0.5) / size and the
+// level of detail comes from the screen space derivatives of the uv, so minified lookups read small levels instead of
+// aliasing over the base level. stored values are filtered as they are, like a GL texture without an srgb format
+//
+// the sampler keeps a pointer to the chain, which has to outlive it
+class Sampler
+{
+ public:
+  // NEAREST and LINEAR filter within the closest level, TRILINEAR blends the two closest levels and ANISOTROPIC
+  // takes up to max_anisotropy trilinear taps along the longer axis of the pixel footprint
+  enum Filter { NEAREST, LINEAR, TRILINEAR, ANISOTROPIC };
+
+  // MIRROR repeats the edge texel like GL_MIRRORED_REPEAT
+  enum Wrap { CLAMP, REPEAT, MIRROR };
+
+  struct Params {
+    Filter filter = TRILINEAR;
+    Wrap wrap_s = REPEAT, wrap_t = REPEAT;
+    float lod_bias = 0.0f;
+    int max_anisotropy = 8;
+  };
+
+  Sampler() noexcept;
+  explicit Sampler(const MipChain& mips);
+  Sampler(const MipChain& mips, const Params& params);
+
+  // dx and dy are the change of the uv to the next pixel to the right and below
+  glm::u8vec4 sample(const glm::vec2& uv, const glm::vec2& dx, const glm::vec2& dy) const;
+  // explicit level of detail, fractional levels are blended with TRILINEAR and ANISOTROPIC
+  glm::u8vec4 sample_lod(const glm::vec2& uv, float lod) const;
+
+  // level the derivatives select, including the bias, clamped to the chain
+  float lod(const glm::vec2& dx, const glm::vec2& dy) const;
+
+  // count lookups with their own derivatives, outside of ANISOTROPIC the levels are selected four at a time
+  void sample_batch(const glm::vec2* uvs, const glm::vec2* dx, const glm::vec2* dy, glm::u8vec4* out,
+                    std::size_t count) const;
+  // same footprint for every lookup, like resampling a whole image to another size
+  void sample_batch(const glm::vec2* uvs, const glm::vec2& dx, const glm::vec2& dy, glm::u8vec4* out,
+                    std::size_t count) const;
+
+  const Params& params() const;
+
+  bool is_valid() const;
+
+ private:
+  struct Level {
+    const unsigned char* data;
+    int width, height;
+  };
+
+  const MipChain* m_mips;
+  Params m_params;
+  std::vector<Level> m_levels;
+  float m_width, m_height;  // of the base level
+
+  struct Footprint {
+    float lod;
+    int taps;
+    glm::vec2 step;  // uv distance between anisotropic taps
+  };
+
+  Footprint footprint(const glm::vec2& dx, const glm::vec2& dy) const;
+  glm::u8vec4 filter(const glm::vec2& uv, const Footprint& footprint) const;
+};
+}  // namespace gfx
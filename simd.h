@@ -0,0 +1,21 @@
+#pragma once
+
+// compile time SIMD detection, every kernel has a scalar fallback for targets without these
+#if defined(__AVX2__)
+#define GFX_AVX2 1
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define GFX_SSE2 1
+#endif
+
+// every AVX2 capable CPU also converts half floats in hardware
+#if defined(__F16C__) || (defined(_MSC_VER) && defined(__AVX2__))
+#define GFX_F16C 1
+#endif
+
+#if defined(GFX_AVX2) || defined(GFX_F16C)
+#include <immintrin.h>
+#elif defined(GFX_SSE2)
+#include <emmintrin.h>
+#endif
@@ -0,0 +1,299 @@
+#include "summed_area_table.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "image_rows.h"
+#include "simd.h"
+#include "thread_pool.h"
+
+namespace gfx
+{
+
+namespace
+{
+
+using detail::load_row;
+using detail::row_grain;
+using detail::store_row;
+
+// the table is in the units of the source, load_row and store_row work on normalized values
+float unit(Image::Type type)
+{
+  switch (type) {
+    case Image::UNSIGNED_BYTE:
+      return 255.0f;
+    case Image::UNSIGNED_SHORT:
+      return 65535.0f;
+    default:
+      return 1.0f;
+  }
+}
+
+// values of one row in the units of the source, 16 bit values are read as they are so their sums stay exact
+void load_units(const unsigned char* src, Image::Type type, float* dst, std::size_t count)
+{
+  if (type == Image::UNSIGNED_SHORT) {
+    const uint16_t* values = reinterpret_cast<const uint16_t*>(src);
+    for (std::size_t i = 0; i < count; i++) dst[i] = values[i];
+  } else {
+    load_row(src, type, dst, count);
+  }
+}
+
+// running sums along a row, dst points past the zero column so dst[i - channels] is always readable
+void prefix_row(const unsigned char* src, uint32_t* dst, int width, int channels)
+{
+  int x = 0;
+#if defined(GFX_SSE2)
+  const __m128i zero = _mm_setzero_si128();
+  if (channels == 4) {
+    // one pixel per register, the running sum carries over from pixel to pixel
+    __m128i sum = zero;
+    for (; x < width; x++) {
+      int texel;
+      std::memcpy(&texel, src + x * 4, 4);
+      sum = _mm_add_epi32(sum, _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(texel), zero), zero));
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x * 4), sum);
+    }
+  } else if (channels == 1) {
+    // in register scan of four values, then the carry of everything before them
+    __m128i carry = zero;
+    for (; x + 4 <= width; x += 4) {
+      int texels;
+      std::memcpy(&texels, src + x, 4);
+      __m128i v = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(texels), zero), zero);
+      v = _mm_add_epi32(v, _mm_slli_si128(v, 4));
+      v = _mm_add_epi32(v, _mm_slli_si128(v, 8));
+      v = _mm_add_epi32(v, carry);
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x), v);
+      carry = _mm_shuffle_epi32(v, _MM_SHUFFLE(3, 3, 3, 3));
+    }
+  }
+#endif
+  for (int i = x * channels; i < width * channels; i++) {
+    dst[i] = dst[i - channels] + src[i];
+  }
+}
+
+void prefix_row(const float* src, double* dst, int width, int channels)
+{
+  int x = 0;
+#if defined(GFX_SSE2)
+  if (channels == 4) {
+    __m128d low = _mm_setzero_pd(), high = _mm_setzero_pd();
+    for (; x < width; x++) {
+      __m128 v = _mm_loadu_ps(src + x * 4);
+      low = _mm_add_pd(low, _mm_cvtps_pd(v));
+      high = _mm_add_pd(high, _mm_cvtps_pd(_mm_movehl_ps(v, v)));
+      _mm_storeu_pd(dst + x * 4, low);
+      _mm_storeu_pd(dst + x * 4 + 2, high);
+    }
+  }
+#endif
+  for (int i = x * channels; i < width * channels; i++) {
+    dst[i] = dst[i - channels] + src[i];
+  }
+}
+
+// dst[i] += src[i]
+void add_row(uint32_t* dst, const uint32_t* src, std::size_t count)
+{
+  std::size_t i = 0;
+#if defined(GFX_SSE2)
+  for (; i + 4 <= count; i += 4) {
+    __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dst + i));
+    __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_add_epi32(a, b));
+  }
+#endif
+  for (; i < count; i++) {
+    dst[i] += src[i];
+  }
+}
+
+void add_row(double* dst, const double* src, std::size_t count)
+{
+  std::size_t i = 0;
+#if defined(GFX_SSE2)
+  for (; i + 2 <= count; i += 2) {
+    _mm_storeu_pd(dst + i, _mm_add_pd(_mm_loadu_pd(dst + i), _mm_loadu_pd(src + i)));
+  }
+#endif
+  for (; i < count; i++) {
+    dst[i] += src[i];
+  }
+}
+
+// the vertical pass, row y of the table is added to row y + 1, threads take strips of columns
+template <typename T>
+void accumulate_columns(std::vector<T>& table, std::size_t stride, int rows)
+{
+  constexpr std::size_t STRIP = 1024;
+  const int strips = static_cast<int>((stride + STRIP - 1) / STRIP);
+
+  ThreadPool::global().parallel_for(0, strips, [&](int begin, int end) {
+    for (int strip = begin; strip < end; strip++) {
+      const std::size_t first = strip * STRIP;
+      const std::size_t count = std::min(STRIP, stride - first);
+      for (int y = 2; y < rows; y++) {
+        add_row(table.data() + y * stride + first, table.data() + (y - 1) * stride + first, count);
+      }
+    }
+  });
+}
+
+}  // namespace
+
+SummedAreaTable::SummedAreaTable() noexcept
+    : m_width(0), m_height(0), m_channels(0), m_type(Image::UNSIGNED_BYTE)
+{
+}
+
+SummedAreaTable::SummedAreaTable(const ImageView& image) : SummedAreaTable()
+{
+  if (!image.is_valid() || image.channels() > 4) {
+    return;
+  }
+
+  m_width = image.width();
+  m_height = image.height();
+  m_channels = image.channels();
+  m_type = image.type();
+
+  const std::size_t values = static_cast<std::size_t>(m_width) * m_channels;
+  const std::size_t stride = static_cast<std::size_t>(m_width + 1) * m_channels;
+  const std::size_t size = stride * (m_height + 1);
+
+  if (m_type == Image::UNSIGNED_BYTE) {
+    m_integer.assign(size, 0);
+    ThreadPool::global().parallel_for(
+        0, m_height,
+        [&](int begin, int end) {
+          for (int y = begin; y < end; y++) {
+            prefix_row(image.row(y), m_integer.data() + index(1, y + 1, 0), m_width, m_channels);
+          }
+        },
+        row_grain(values));
+    accumulate_columns(m_integer, stride, m_height + 1);
+    return;
+  }
+
+  m_double.assign(size, 0.0);
+  ThreadPool::global().parallel_for(
+      0, m_height,
+      [&](int begin, int end) {
+        std::vector<float> row(values);
+        for (int y = begin; y < end; y++) {
+          load_units(image.row(y), m_type, row.data(), values);
+          prefix_row(row.data(), m_double.data() + index(1, y + 1, 0), m_width, m_channels);
+        }
+      },
+      row_grain(values));
+  accumulate_columns(m_double, stride, m_height + 1);
+}
+
+glm::dvec4 SummedAreaTable::sum(int x, int y, int width, int height) const
+{
+  glm::dvec4 result(0.0);
+
+  const int x0 = std::clamp(x, 0, m_width), y0 = std::clamp(y, 0, m_height);
+  const int x1 = std::clamp(x + width, x0, m_width), y1 = std::clamp(y + height, y0, m_height);
+  if (!is_valid() || x0 == x1 || y0 == y1) {
+    return result;
+  }
+
+  for (int c = 0; c < m_channels; c++) {
+    if (!m_integer.empty()) {
+      // unsigned wrap around cancels out as long as the true sum fits
+      uint32_t s = m_integer[index(x1, y1, c)] - m_integer[index(x0, y1, c)] - m_integer[index(x1, y0, c)] +
+                   m_integer[index(x0, y0, c)];
+      result[c] = s;
+    } else {
+      result[c] = m_double[index(x1, y1, c)] - m_double[index(x0, y1, c)] - m_double[index(x1, y0, c)] +
+                  m_double[index(x0, y0, c)];
+    }
+  }
+
+  return result;
+}
+
+glm::vec4 SummedAreaTable::mean(int x, int y, int width, int height) const
+{
+  const int x0 = std::clamp(x, 0, m_width), y0 = std::clamp(y, 0, m_height);
+  const int x1 = std::clamp(x + width, x0, m_width), y1 = std::clamp(y + height, y0, m_height);
+  if (x0 == x1 || y0 == y1) {
+    return glm::vec4(0.0f);
+  }
+  return glm::vec4(sum(x0, y0, x1 - x0, y1 - y0) / (static_cast<double>(x1 - x0) * (y1 - y0)));
+}
+
+int SummedAreaTable::width() const { return m_width; }
+
+int SummedAreaTable::height() const { return m_height; }
+
+int SummedAreaTable::channels() const { return m_channels; }
+
+Image::Type SummedAreaTable::type() const { return m_type; }
+
+std::size_t SummedAreaTable::size_bytes() const
+{
+  return m_integer.size() * sizeof(uint32_t) + m_double.size() * sizeof(double);
+}
+
+bool SummedAreaTable::is_valid() const { return !m_integer.empty() || !m_double.empty(); }
+
+Image variable_box_blur(const ImageView& image, const ImageView& radius, float max_radius)
+{
+  if (!image.is_valid() || !radius.is_valid() || radius.width() != image.width() ||
+      radius.height() != image.height()) {
+    return Image();
+  }
+
+  SummedAreaTable table(image);
+  if (!table.is_valid()) {
+    return Image();
+  }
+
+  const int width = image.width(), height = image.height(), channels = image.channels();
+  // means are in the units of the source
+  const float normalize = 1.0f / unit(image.type());
+
+  Image result(width, height, channels, image.type());
+  if (!result.is_valid()) {
+    return result;
+  }
+
+  const std::size_t stride = static_cast<std::size_t>(width) * result.bytes_per_pixel();
+  const std::size_t values = static_cast<std::size_t>(width) * channels;
+
+  ThreadPool::global().parallel_for(
+      0, height,
+      [&](int begin, int end) {
+        std::vector<float> radii(static_cast<std::size_t>(width) * radius.channels());
+        std::vector<float> out(values);
+        for (int y = begin; y < end; y++) {
+          load_row(radius.row(y), radius.type(), radii.data(), radii.size());
+          for (int x = 0; x < width; x++) {
+            float r = std::max(radii[static_cast<std::size_t>(x) * radius.channels()] * max_radius, 0.0f);
+            int r0 = static_cast<int>(r);
+            float t = r - static_cast<float>(r0);
+
+            glm::vec4 m = table.mean(x - r0, y - r0, 2 * r0 + 1, 2 * r0 + 1);
+            if (t > 0.0f) {
+              m = glm::mix(m, table.mean(x - r0 - 1, y - r0 - 1, 2 * r0 + 3, 2 * r0 + 3), t);
+            }
+            for (int c = 0; c < channels; c++) {
+              out[static_cast<std::size_t>(x) * channels + c] = m[c] * normalize;
+            }
+          }
+          store_row(out.data(), result.type(), result.data() + y * stride, values);
+        }
+      },
+      row_grain(values));
+
+  return result;
+}
+
+}  // namespace gfx
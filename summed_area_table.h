@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <vector>
+
+#include "image.h"
+#include "image_view.h"
+
+namespace gfx
+{
+// integral image for constant time sums and means over any rectangle, per channel
+//
+// 8 bit images are summed in 32 bit integers, rectangle sums stay exact as long as the rectangle is under 16.8M
+// pixels since the wrap around cancels out. other types are summed in double, which is exact for 16 bit images as
+// their sums stay integers under 2^53. for half float and float images the error of any rectangle sum is at most
+// (image width + image height + 1) * 2^-51 times the sum of the absolute values of the image, under 6e-5 for a
+// 4096x4096 image of values in [0, 1]. sums are in the units of the source, 0 to 255 for 8 bit, 0 to 65535 for 16
+// bit and the values themselves for float and half float
+class SummedAreaTable
+{
+ public:
+  SummedAreaTable() noexcept;
+  // rows are summed in parallel, then strips of columns
+  explicit SummedAreaTable(const ImageView& image);
+
+  // over the pixels in [x, x + width) x [y, y + height), clipped to the image, unused channels are 0
+  glm::dvec4 sum(int x, int y, int width, int height) const;
+  glm::vec4 mean(int x, int y, int width, int height) const;
+
+  int width() const;
+  int height() const;
+  int channels() const;
+  Image::Type type() const;  // of the source
+  std::size_t size_bytes() const;
+
+  bool is_valid() const;
+
+ private:
+  std::vector<uint32_t> m_integer;  // 8 bit sources
+  std::vector<double> m_double;     // everything else
+  int m_width, m_height, m_channels;
+  Image::Type m_type;
+
+  // one leading row and column of zeros, so queries need no edge cases
+  inline std::size_t index(int x, int y, int c) const
+  {
+    return (static_cast<std::size_t>(y) * (m_width + 1) + x) * m_channels + c;
+  }
+};
+
+// box blur whose radius changes per pixel, like a depth of field or a roughness driven blur. radius is a single
+// channel map of the image size, its values in [0, 1] scale max_radius. fractional radii blend the two closest boxes
+// and boxes are clipped at the edges, four table lookups per box whatever the radius
+Image variable_box_blur(const ImageView& image, const ImageView& radius, float max_radius);
+}  // namespace gfx
@@ -0,0 +1,124 @@
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <limits>
+#include <memory>
+
+namespace gfx
+{
+
+ThreadPool::ThreadPool(unsigned num_threads)
+{
+  num_threads = std::max(num_threads, 1U);
+  m_workers.reserve(num_threads);
+  for (unsigned i = 0; i < num_threads; i++) {
+    m_workers.emplace_back(&ThreadPool::run, this);
+  }
+}
+
+ThreadPool::~ThreadPool()
+{
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stop = true;
+  }
+  m_condition.notify_all();
+  for (std::thread& worker : m_workers) {
+    worker.join();
+  }
+}
+
+unsigned ThreadPool::size() const { return static_cast<unsigned>(m_workers.size()); }
+
+void ThreadPool::submit(std::function<void()> task, int priority)
+{
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_tasks.push({priority, m_sequence++, std::move(task)});
+  }
+  m_condition.notify_one();
+}
+
+void ThreadPool::run()
+{
+  while (true) {
+    std::function<void()> task;
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_condition.wait(lock, [this] { return m_stop || !m_tasks.empty(); });
+      if (m_stop && m_tasks.empty()) {
+        return;
+      }
+      // top() is const, the task is popped right after so moving from it is fine
+      task = std::move(const_cast<Task&>(m_tasks.top()).function);
+      m_tasks.pop();
+    }
+    task();
+  }
+}
+
+void ThreadPool::parallel_for(int begin, int end, const std::function<void(int, int)>& body, int grain)
+{
+  if (end <= begin) {
+    return;
+  }
+
+  const int count = end - begin;
+  grain = std::max(grain, 1);
+
+  // a few chunks per thread balance uneven work without much scheduling overhead
+  const int max_chunks = static_cast<int>(size() + 1) * 4;
+  const int chunks = std::min((count + grain - 1) / grain, max_chunks);
+
+  if (chunks <= 1) {
+    body(begin, end);
+    return;
+  }
+
+  const int chunk_size = (count + chunks - 1) / chunks;
+
+  struct State {
+    std::atomic<int> next{0};
+    std::atomic<int> done{0};
+    std::mutex mutex;
+    std::condition_variable condition;
+  };
+
+  auto state = std::make_shared<State>();
+
+  // body is only touched while a chunk is claimed, and all chunks finish before we return
+  auto work = [state, &body, begin, end, chunks, chunk_size]() {
+    int chunk;
+    while ((chunk = state->next.fetch_add(1)) < chunks) {
+      int chunk_begin = begin + chunk * chunk_size;
+      int chunk_end = std::min(end, chunk_begin + chunk_size);
+      if (chunk_begin < chunk_end) {
+        body(chunk_begin, chunk_end);
+      }
+      if (state->done.fetch_add(1) + 1 == chunks) {
+        std::lock_guard<std::mutex> lock(state->mutex);
+        state->condition.notify_all();
+      }
+    }
+  };
+
+  // helpers jump the queue, the caller is blocked until the loop is done
+  const int helpers = std::min(chunks - 1, static_cast<int>(size()));
+  for (int i = 0; i < helpers; i++) {
+    submit(work, std::numeric_limits<int>::max());
+  }
+
+  work();
+
+  std::unique_lock<std::mutex> lock(state->mutex);
+  state->condition.wait(lock, [&state, chunks] { return state->done.load() == chunks; });
+}
+
+ThreadPool& ThreadPool::global()
+{
+  static ThreadPool pool;
+  return pool;
+}
+
+}  // namespace gfx
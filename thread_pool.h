@@ -0,0 +1,54 @@
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+namespace gfx
+{
+class ThreadPool
+{
+ public:
+  explicit ThreadPool(unsigned num_threads = std::thread::hardware_concurrency());
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  unsigned size() const;
+
+  // tasks with a higher priority run first, equal priorities run in submission order
+  void submit(std::function<void()> task, int priority = 0);
+
+  // split [begin, end) into chunks of at least grain items and wait for all of them,
+  // the calling thread works on chunks as well so nested calls cannot deadlock
+  void parallel_for(int begin, int end, const std::function<void(int, int)>& body, int grain = 1);
+
+  // shared pool sized to the hardware
+  static ThreadPool& global();
+
+ private:
+  std::vector<std::thread> m_workers;
+  struct Task {
+    int priority;
+    unsigned long long sequence;
+    std::function<void()> function;
+
+    bool operator<(const Task& other) const
+    {
+      return priority != other.priority ? priority < other.priority : sequence > other.sequence;
+    }
+  };
+
+  std::priority_queue<Task> m_tasks;
+  unsigned long long m_sequence = 0;
+  std::mutex m_mutex;
+  std::condition_variable m_condition;
+  bool m_stop = false;
+
+  void run();
+};
+}  // namespace gfx
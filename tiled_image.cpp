@@ -0,0 +1,168 @@
+#include "tiled_image.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+#include "simd.h"
+#include "thread_pool.h"
+
+namespace gfx
+{
+
+namespace
+{
+
+// one tile row is 8, 16, 24 or 32 bytes, full rgba rows take two vector moves
+inline void copy_tile_row(unsigned char* dst, const unsigned char* src, std::size_t len)
+{
+#if defined(GFX_SSE2)
+  if (len == 32) {
+    __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+    __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 16));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst), a);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 16), b);
+    return;
+  }
+#endif
+  std::memcpy(dst, src, len);
+}
+
+template <typename Copy>
+void for_each_tile_row(int width, int height, int channels, int tiles_x, Copy copy)
+{
+  constexpr int T = TiledImage::TILE_SIZE;
+  const int tiles_y = (height + T - 1) / T;
+
+  ThreadPool::global().parallel_for(0, tiles_y, [&](int begin, int end) {
+    for (int ty = begin; ty < end; ty++) {
+      for (int r = 0; r < T && ty * T + r < height; r++) {
+        int y = ty * T + r;
+        for (int tx = 0; tx < tiles_x; tx++) {
+          int x = tx * T;
+          int count = std::min(T, width - x);
+          std::size_t tiled = ((static_cast<std::size_t>(ty) * tiles_x + tx) * T * T + r * T) * channels;
+          copy(tiled, x, y, static_cast<std::size_t>(count) * channels);
+        }
+      }
+    }
+  });
+}
+
+}  // namespace
+
+TiledImage::TiledImage() noexcept : m_width(0), m_height(0), m_channels(0), m_tiles_x(0) {}
+
+TiledImage::TiledImage(int width, int height, int channels)
+    : m_width(width), m_height(height), m_channels(channels), m_tiles_x((width + TILE_SIZE - 1) / TILE_SIZE)
+{
+  if (width > 0 && height > 0 && channels > 0) {
+    int tiles_y = (height + TILE_SIZE - 1) / TILE_SIZE;
+    m_data.resize(static_cast<std::size_t>(m_tiles_x) * tiles_y * TILE_SIZE * TILE_SIZE * channels);
+  }
+}
+
+TiledImage::TiledImage(const ImageView& view) : TiledImage()
+{
+  if (!view.is_valid() || view.type() != Image::UNSIGNED_BYTE) {
+    return;
+  }
+
+  *this = TiledImage(view.width(), view.height(), view.channels());
+
+  unsigned char* data = m_data.data();
+  for_each_tile_row(m_width, m_height, m_channels, m_tiles_x, [&](std::size_t tiled, int x, int y, std::size_t len) {
+    copy_tile_row(data + tiled, view.row(y) + static_cast<std::size_t>(x) * m_channels, len);
+  });
+}
+
+Image TiledImage::to_image() const
+{
+  if (!is_valid()) {
+    return Image();
+  }
+
+  Image image(m_width, m_height, m_channels);
+  if (!image.is_valid()) {
+    return image;
+  }
+
+  ImageView view(image);
+  const unsigned char* data = m_data.data();
+  for_each_tile_row(m_width, m_height, m_channels, m_tiles_x, [&](std::size_t tiled, int x, int y, std::size_t len) {
+    copy_tile_row(view.row(y) + static_cast<std::size_t>(x) * m_channels, data + tiled, len);
+  });
+
+  return image;
+}
+
+const unsigned char* TiledImage::data() const { return m_data.data(); }
+
+int TiledImage::width() const { return m_width; }
+
+int TiledImage::height() const { return m_height; }
+
+int TiledImage::channels() const { return m_channels; }
+
+std::size_t TiledImage::size_bytes() const { return m_data.size(); }
+
+bool TiledImage::is_valid() const { return !m_data.empty(); }
+
+void TiledImage::set_pixel(int x, int y, const unsigned char* pixel)
+{
+  if (is_valid() && (0 <= x && x < m_width) && (0 <= y && y < m_height)) {
+    std::memcpy(m_data.data() + offset(x, y), pixel, m_channels);
+  }
+}
+
+glm::u8vec4 TiledImage::pixel(int x, int y) const
+{
+  glm::u8vec4 pixel(0);
+
+  if (is_valid() && (0 <= x && x < m_width) && (0 <= y && y < m_height)) {
+    const unsigned char* p = m_data.data() + offset(x, y);
+    for (int c = 0; c < glm::min(m_channels, 4); c++) {
+      pixel[c] = p[c];
+    }
+  }
+
+  return pixel;
+}
+
+glm::u8vec4 TiledImage::sample(const glm::vec2& uv, Image::Sampling algorithm) const
+{
+  if (!is_valid() || !(0.f <= uv.x && uv.x <= 1.0f) || !(0.f <= uv.y && uv.y <= 1.0f)) {
+    return glm::u8vec4(0);
+  }
+
+  switch (algorithm) {
+    // nearest neighbour
+    case Image::NEAREST: {
+      int x = static_cast<int>(uv.x * (m_width - 1));
+      int y = static_cast<int>(uv.y * (m_height - 1));
+      return pixel(x, y);
+    }
+    // bilinear interpolation, the neighbours are clamped to the edge
+    case Image::LINEAR: {
+      float x = uv.x * (m_width - 1);
+      float y = uv.y * (m_height - 1);
+
+      int x0 = static_cast<int>(x);
+      int y0 = static_cast<int>(y);
+      int x1 = glm::min(x0 + 1, m_width - 1);
+      int y1 = glm::min(y0 + 1, m_height - 1);
+      float x_frac = x - x0;
+      float y_frac = y - y0;
+
+      glm::vec4 t = glm::mix(glm::vec4(pixel(x0, y0)), glm::vec4(pixel(x1, y0)), x_frac);
+      glm::vec4 b = glm::mix(glm::vec4(pixel(x0, y1)), glm::vec4(pixel(x1, y1)), x_frac);
+
+      return glm::u8vec4(glm::mix(t, b, y_frac) + 0.5f);
+    }
+    default:
+      assert(false);
+      return glm::u8vec4();
+  }
+}
+
+}  // namespace gfx
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstddef>
+#include <glm/glm.hpp>
+#include <vector>
+
+#include "image.h"
+#include "image_view.h"
+
+namespace gfx
+{
+// 8 bit image stored as 8x8 pixel tiles, neighbourhoods and rotated lookups touch far fewer cache lines
+// than with row major storage, convert back with to_image() for upload or output
+class TiledImage
+{
+ public:
+  static constexpr int TILE_SIZE = 8;
+
+  TiledImage() noexcept;
+  TiledImage(int width, int height, int channels);
+  explicit TiledImage(const ImageView& view);
+
+  Image to_image() const;
+
+  const unsigned char* data() const;
+  int width() const;
+  int height() const;
+  int channels() const;
+  std::size_t size_bytes() const;  // including the padding of partial edge tiles
+
+  glm::u8vec4 pixel(int x, int y) const;
+  glm::u8vec4 sample(const glm::vec2&, Image::Sampling algorithm = Image::NEAREST) const;
+
+  void set_pixel(int x, int y, const unsigned char* pixel);
+
+  bool is_valid() const;
+
+ private:
+  std::vector<unsigned char> m_data;
+  int m_width, m_height, m_channels;
+  int m_tiles_x;
+
+  inline std::size_t offset(int x, int y) const
+  {
+    std::size_t tile = static_cast<std::size_t>(y / TILE_SIZE) * m_tiles_x + (x / TILE_SIZE);
+    return (tile * TILE_SIZE * TILE_SIZE + (y % TILE_SIZE) * TILE_SIZE + (x % TILE_SIZE)) * m_channels;
+  }
+};
+}  // namespace gfx
@@ -0,0 +1,176 @@
+#pragma once
+
+#include <cassert>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <type_traits>
+#include <utility>
+
+#include "image.h"
+#include "image_convert.h"
+#include "image_view.h"
+
+namespace gfx
+{
+// channel type of half float images, pixels of TypedImage<N, half> are read and written as floats
+struct half {
+  uint16_t bits;
+};
+
+namespace detail
+{
+// storage and pixel types of every channel type TypedImage supports
+template <typename T>
+struct ChannelTraits;
+
+template <>
+struct ChannelTraits<unsigned char> {
+  using value_type = unsigned char;
+  static constexpr Image::Type type = Image::UNSIGNED_BYTE;
+  static value_type load(unsigned char v) { return v; }
+  static unsigned char store(value_type v) { return v; }
+};
+
+template <>
+struct ChannelTraits<uint16_t> {
+  using value_type = uint16_t;
+  static constexpr Image::Type type = Image::UNSIGNED_SHORT;
+  static value_type load(uint16_t v) { return v; }
+  static uint16_t store(value_type v) { return v; }
+};
+
+template <>
+struct ChannelTraits<half> {
+  using value_type = float;
+  static constexpr Image::Type type = Image::HALF_FLOAT;
+  static value_type load(half v) { return half_to_float(v.bits); }
+  static half store(value_type v) { return half{float_to_half(v)}; }
+};
+
+template <>
+struct ChannelTraits<float> {
+  using value_type = float;
+  static constexpr Image::Type type = Image::FLOAT;
+  static value_type load(float v) { return v; }
+  static float store(value_type v) { return v; }
+};
+}  // namespace detail
+
+// image with the channel count and type fixed at compile time, so per pixel access compiles to a few unrolled
+// loads and stores instead of the channel and type switches of Image. pixels are glm vectors in the units of the
+// storage, 0 to 255 for 8 bit, 0 to 65535 for 16 bit and floats for half float and float images
+//
+// the pixels live in an Image, converting to and from one with matching channels and type moves the buffer
+template <int N, typename T>
+class TypedImage
+{
+  static_assert(1 <= N && N <= 4, "1 to 4 channels");
+
+ public:
+  using Traits = detail::ChannelTraits<T>;
+  using Pixel = glm::vec<N, typename Traits::value_type>;
+
+  static constexpr int CHANNELS = N;
+  static constexpr Image::Type TYPE = Traits::type;
+
+  TypedImage() noexcept = default;
+  TypedImage(int width, int height) noexcept : m_image(width, height, N, TYPE) {}
+
+  // takes the pixels of image if its channels and type match, otherwise the result is invalid
+  explicit TypedImage(Image&& image) noexcept
+  {
+    if (matches(image.channels(), image.type())) {
+      m_image = std::move(image);
+    }
+  }
+
+  // copy of any valid image, converted like Image::convert
+  static TypedImage from(const Image& image)
+  {
+    if (!image.is_valid()) {
+      return TypedImage();
+    }
+    return TypedImage(image.convert(N, TYPE));
+  }
+
+  static bool matches(int channels, Image::Type type) { return channels == N && type == TYPE; }
+
+  // the untyped image, this one is invalid afterwards
+  Image release() { return std::move(m_image); }
+
+  const Image& image() const { return m_image; }
+  ImageView view() const { return ImageView(m_image); }
+
+  T* data() const { return reinterpret_cast<T*>(m_image.data()); }
+  T* row(int y) const { return data() + static_cast<std::size_t>(y) * m_image.width() * N; }
+  int width() const { return m_image.width(); }
+  int height() const { return m_image.height(); }
+  bool is_valid() const { return m_image.is_valid(); }
+
+  // no bounds checks outside of debug builds, these are meant for tight loops
+  Pixel pixel(int x, int y) const
+  {
+    assert(0 <= x && x < width() && 0 <= y && y < height());
+    const T* p = row(y) + x * N;
+    Pixel pixel;
+    for (int c = 0; c < N; c++) {
+      pixel[c] = Traits::load(p[c]);
+    }
+    return pixel;
+  }
+
+  void set_pixel(int x, int y, const Pixel& pixel)
+  {
+    assert(0 <= x && x < width() && 0 <= y && y < height());
+    T* p = row(y) + x * N;
+    for (int c = 0; c < N; c++) {
+      p[c] = Traits::store(pixel[c]);
+    }
+  }
+
+  // same coordinates as Image::sample, uv outside [0, 1] gives 0. integer channels are rounded
+  Pixel sample(const glm::vec2& uv, Image::Sampling algorithm = Image::NEAREST) const
+  {
+    if (!is_valid() || !(0.f <= uv.x && uv.x <= 1.0f) || !(0.f <= uv.y && uv.y <= 1.0f)) {
+      return Pixel(0);
+    }
+
+    float x = uv.x * (width() - 1);
+    float y = uv.y * (height() - 1);
+    int x0 = static_cast<int>(x);
+    int y0 = static_cast<int>(y);
+
+    if (algorithm == Image::NEAREST) {
+      return pixel(x0, y0);
+    }
+
+    // bilinear interpolation, the neighbours are clamped to the edge
+    using Vec = glm::vec<N, float>;
+    int x1 = glm::min(x0 + 1, width() - 1);
+    int y1 = glm::min(y0 + 1, height() - 1);
+    float x_frac = x - x0;
+    float y_frac = y - y0;
+
+    Vec t = glm::mix(Vec(pixel(x0, y0)), Vec(pixel(x1, y0)), x_frac);
+    Vec b = glm::mix(Vec(pixel(x0, y1)), Vec(pixel(x1, y1)), x_frac);
+    Vec v = glm::mix(t, b, y_frac);
+
+    if constexpr (std::is_integral_v<typename Traits::value_type>) {
+      v += 0.5f;
+    }
+    return Pixel(v);
+  }
+
+ private:
+  Image m_image;
+};
+
+using R8 = TypedImage<1, unsigned char>;
+using Rgb8 = TypedImage<3, unsigned char>;
+using Rgba8 = TypedImage<4, unsigned char>;
+using R16 = TypedImage<1, uint16_t>;
+using Rgba16 = TypedImage<4, uint16_t>;
+using Rgba16f = TypedImage<4, half>;
+using Rgb32f = TypedImage<3, float>;
+using Rgba32f = TypedImage<4, float>;
+}  // namespace gfx